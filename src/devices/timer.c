@@ -1,12 +1,15 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
+#include "kernel/gdt.h"
 #include "kernel/interrupt.h"
 #include "kernel/synch.h"
 #include "kernel/thread.h"
+#include "kernel/vdso.h"
   
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -20,21 +23,70 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Timing wheel of sleeping threads.  A thread that wakes at tick
+   T sits in slot T % WHEEL_SLOTS, whose list is kept sorted by
+   wakeup tick, so each timer interrupt looks only at the front of
+   one slot.  Putting a thread to sleep walks just the threads of
+   its own slot, about 1/WHEEL_SLOTS of all sleepers, and waking
+   one costs O(1). */
+#define WHEEL_SLOTS 64
+static struct list wheel[WHEEL_SLOTS];
+
+/* Tickless idle.  When the idle thread halts, the PIT is switched
+   from periodic mode to a countdown that ends at the next
+   sleeper's wakeup tick, and the ticks that pass meanwhile are
+   counted up on wakeup.  The PIT's 16-bit counter holds at most
+   about 55 ms, so a longer countdown is a chain of one-shots: the
+   interrupt ending each but the last only starts the next, and
+   the idle thread halts again unless a thread became ready.
+
+   Time is counted in PIT cycles and turned into ticks with the
+   fraction of a tick left over carried into the next count, so
+   that stopping and restarting the PIT does not make TICKS fall
+   behind. */
+#define TICKLESS_MAX_TICKS (10 * TIMER_FREQ)
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+static bool tickless;           /* Counting down rather than periodic. */
+static int64_t tickless_done;   /* PIT cycles in finished one-shots. */
+static int64_t tickless_left;   /* PIT cycles in one-shots to come. */
+static uint16_t tickless_count; /* PIT cycles in the current one-shot. */
+static uint32_t tick_carry;     /* PIT cycles times TIMER_FREQ not yet
+                                   counted as a tick, below PIT_HZ. */
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Time stamp counter, which counts CPU cycles.  Calibrated
+   against the PIT by timer_calibrate(); until then, or if the CPU
+   has no TSC, tsc_hz is 0 and timer_ns() falls back to ticks. */
+#define TSC_CALIBRATE_TICKS 10
+static uint64_t tsc_hz;         /* TSC cycles per second. */
+static uint64_t tsc_base;       /* TSC at the start of tick TICKS_BASE. */
+static int64_t ticks_base;      /* Tick at which the TSC was read. */
+
 static intr_handler_func timer_interrupt;
+static list_less_func wakeup_less;
+static void timer_advance (int64_t, bool user);
+static void tickless_arm (void);
+static int64_t tickless_end (int64_t cycles);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static bool tsc_present (void);
+static inline uint64_t rdtsc (void);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void) 
 {
+  size_t i;
+
+  for (i = 0; i < WHEEL_SLOTS; i++)
+    list_init (&wheel[i]);
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -64,6 +116,45 @@ timer_calibrate (void)
       loops_per_tick |= test_bit;
 
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+  /* Count TSC cycles over a few ticks, starting and ending right
+     at a tick. */
+  if (tsc_present ())
+    {
+      int64_t start;
+      uint64_t tsc_start;
+
+      start = ticks;
+      while (ticks == start)
+        barrier ();
+      start = ticks;
+      tsc_start = rdtsc ();
+      while (ticks < start + TSC_CALIBRATE_TICKS)
+        barrier ();
+      tsc_base = rdtsc ();
+      ticks_base = ticks;
+      tsc_hz = (tsc_base - tsc_start) * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+      vdso_set_tsc (tsc_hz, tsc_base, ticks_base);
+      printf ("TSC: %'"PRIu64" Hz.\n", tsc_hz);
+    }
+}
+
+/* Returns the number of nanoseconds since the OS booted, to the
+   resolution of the TSC once calibrated, and to a timer tick
+   before then.  The value never goes backward. */
+int64_t
+timer_ns (void) 
+{
+  uint64_t cycles;
+
+  if (tsc_hz == 0)
+    return timer_ticks () * (1000 * 1000 * 1000 / TIMER_FREQ);
+
+  /* Split the conversion so that CYCLES * 10^9 cannot overflow. */
+  cycles = rdtsc () - tsc_base;
+  return ticks_base * (1000 * 1000 * 1000 / TIMER_FREQ)
+         + cycles / tsc_hz * 1000 * 1000 * 1000
+         + cycles % tsc_hz * 1000 * 1000 * 1000 / tsc_hz;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -85,15 +176,65 @@ timer_elapsed (int64_t then)
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.  The thread blocks on the timing wheel until the
+   timer interrupt wakes it. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable ();
+  timer_block (ticks);
+  intr_set_level (old_level);
+}
+
+/* Blocks the current thread, as thread_block() does, until
+   another thread unblocks it or TICKS timer ticks pass, whichever
+   comes first.  If TICKS is not positive, there is no timeout.
+   Returns true if the timeout ended the wait.  Interrupts must be
+   off.
+
+   A thread that unblocks a sleeper must first call timer_cancel()
+   on it, or the timer could unblock it a second time.  A sleeper
+   that was not cancelled takes itself off the wheel. */
+bool
+timer_block (int64_t ticks)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (ticks <= 0)
+    {
+      thread_block ();
+      return false;
+    }
+
+  cur->wakeup_tick = timer_ticks () + ticks;
+  list_insert_ordered (&wheel[cur->wakeup_tick % WHEEL_SLOTS],
+                       &cur->sleep_elem, wakeup_less, NULL);
+  cur->sleeping = true;
+  thread_block ();
+  timer_cancel (cur);
+  return timer_ticks () >= cur->wakeup_tick;
+}
+
+/* Takes T, which is blocked in timer_block() or has just been
+   woken from it, off the timing wheel, so that its timeout cannot
+   unblock it.  Does nothing if T is not on the wheel.  Interrupts
+   must be off. */
+void
+timer_cancel (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (t->sleeping)
+    {
+      list_remove (&t->sleep_elem);
+      t->sleeping = false;
+    }
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -166,12 +307,170 @@ timer_print_stats (void)
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  If no sleeper is due on the next tick, switches the PIT
+   to a countdown ending at the first tick on which one is, at tick
+   DEADLINE, or TICKLESS_MAX_TICKS ahead, whichever comes first. */
+void
+timer_idle_enter (int64_t deadline)
+{
+  int64_t wake = ticks + TICKLESS_MAX_TICKS;
+  uint16_t left;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Each slot's front thread is its earliest sleeper. */
+  if (deadline < wake)
+    wake = deadline;
+  for (i = 0; i < WHEEL_SLOTS; i++)
+    if (!list_empty (&wheel[i]))
+      {
+        struct thread *t = list_entry (list_front (&wheel[i]),
+                                       struct thread, sleep_elem);
+        if (t->wakeup_tick < wake)
+          wake = t->wakeup_tick;
+      }
+  if (wake <= ticks + 1)
+    return;
+
+  /* Count the part of the current tick that has passed, which
+     reprogramming the PIT would otherwise lose. */
+  left = pit_read_counter (0);
+  if (left <= TICK_CYCLES)
+    tick_carry += (TICK_CYCLES - left) * TIMER_FREQ;
+
+  tickless = true;
+  tickless_done = 0;
+  tickless_left = DIV_ROUND_UP ((wake - ticks) * PIT_HZ - tick_carry,
+                                TIMER_FREQ);
+  tickless_arm ();
+}
+
+/* Returns true while a tickless countdown runs. */
+bool
+timer_idle_sleeping (void)
+{
+  return tickless;
+}
+
+/* Called by the idle thread before it gives up the CPU after a
+   halt.  If the countdown has not run out, counts the ticks that
+   passed from what is left on the PIT and goes back to periodic
+   ticks. */
+void
+timer_idle_exit (void)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (tickless)
+    {
+      int64_t cycles = tickless_done;
+
+      /* A one-shot that ran out did so while interrupts were off,
+         and its interrupt, still pending, will count as a periodic
+         tick, so leave that tick out here. */
+      if (pit_output (0))
+        cycles += tickless_count - TICK_CYCLES;
+      else
+        cycles += tickless_count - pit_read_counter (0);
+      timer_advance (tickless_end (cycles > 0 ? cycles : 0), false);
+    }
+  intr_set_level (old_level);
+}
+
+/* Starts the next one-shot of the tickless countdown, of as many
+   of the cycles left as the PIT holds. */
+static void
+tickless_arm (void)
+{
+  tickless_count = tickless_left < 65535 ? tickless_left : 65535;
+  tickless_left -= tickless_count;
+  pit_oneshot (0, tickless_count);
+}
+
+/* Ends the tickless countdown, CYCLES PIT cycles after it began,
+   and goes back to periodic ticks.  Returns the whole ticks that
+   passed and carries what is left into tick_carry. */
+static int64_t
+tickless_end (int64_t cycles)
+{
+  uint64_t scaled = (uint64_t) cycles * TIMER_FREQ + tick_carry;
+
+  tickless = false;
+  pit_configure_channel (0, 2, TIMER_FREQ);
+  tick_carry = scaled % PIT_HZ;
+  return scaled / PIT_HZ;
+}
+
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
+{
+  bool user = args->cs == SEL_UCSEG;
+
+  if (tickless)
+    {
+      tickless_done += tickless_count;
+      if (tickless_left > 0)
+        {
+          /* Not there yet: chain the next one-shot. */
+          tickless_arm ();
+          return;
+        }
+
+      /* End of the countdown: catch up, then go back to periodic
+         ticks. */
+      timer_advance (tickless_end (tickless_done), user);
+    }
+  else
+    timer_advance (1, user);
+}
+
+/* Advances the tick count by N, waking the threads whose time
+   has come and running the scheduler's tick work for each tick,
+   which USER says was spent in user mode.  Interrupts must be
+   off. */
+static void
+timer_advance (int64_t n, bool user)
 {
-  ticks++;
-  thread_tick ();
+  while (n-- > 0)
+    {
+      struct list *slot;
+
+      ticks++;
+      vdso_set_ticks (ticks);
+
+      /* Wake the threads whose time has come.  Threads further
+         down this slot are due a whole turn of the wheel later or
+         more. */
+      slot = &wheel[ticks % WHEEL_SLOTS];
+      while (!list_empty (slot))
+        {
+          struct thread *t = list_entry (list_front (slot), struct thread,
+                                         sleep_elem);
+          if (t->wakeup_tick > ticks)
+            break;
+          list_pop_front (slot);
+          t->sleeping = false;
+          thread_unblock (t);
+          if (intr_context ())
+            thread_preempt (t);
+        }
+
+      thread_tick (user);
+    }
+}
+
+/* Orders threads on the timing wheel by wakeup tick. */
+static bool
+wakeup_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, sleep_elem);
+  const struct thread *b = list_entry (b_, struct thread, sleep_elem);
+
+  return a->wakeup_tick < b->wakeup_tick;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -242,5 +541,37 @@ real_time_delay (int64_t num, int32_t denom)
   /* Scale the numerator and denominator down by 1000 to avoid
      the possibility of overflow. */
   ASSERT (denom % 1000 == 0);
+
+  /* Once calibrated, the TSC gives the exact cycles to wait,
+     however the loop below happens to be aligned. */
+  if (tsc_hz != 0)
+    {
+      uint64_t end = rdtsc () + tsc_hz * num / 1000 / (denom / 1000);
+      while (rdtsc () < end)
+        barrier ();
+      return;
+    }
+
   busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
 }
+
+/* Returns true if the CPU has a time stamp counter, according to
+   CPUID function 1, EDX bit 4. */
+static bool
+tsc_present (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  return (edx & (1u << 4)) != 0;
+}
+
+/* Returns the time stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <syscall-nr.h>
 #include "kernel/gdt.h"
 #include "kernel/interrupt.h"
 #include "kernel/thread.h"
@@ -21,6 +22,11 @@ static long long page_fault_cnt;
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
 
+/* The instructions in copy_from_user() and copy_to_user() that
+   touch user memory. */
+extern char copy_from_user_insn[];
+extern char copy_to_user_insn[];
+
 //static bool load_page(void *);
 
 /* Registers handlers for interrupts that can be caused by user
@@ -160,38 +166,70 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* Handle bad dereferences from system call implementations. */
-  if (!user)
-  {
-    f->eip = (void (*) (void)) f->eax;
-    f->eax = 0;
-  }
-
   void *f_paddr = pg_round_down (fault_addr);
 
   if (!thread_current ())
     PANIC ("Current thread is null.");
 
   struct spt *spt = thread_current ()->spt;
-
-  lock_acquire (&spt->lock);
-    struct page *f_page = page_lookup (&spt->table, f_paddr);
-  lock_release (&spt->lock);
+  struct page *f_page;
+  bool resolved = false;
 
   if (is_kernel_vaddr (fault_addr) ||               // Kernel access
       fault_addr == 0 ||                            // Null dereference
       (write && 
         ((unsigned) pagedir_get_page (thread_current()->
         pagedir, fault_addr) & PTE_W)))             // Write on read-only memory
-    thread_exit ();
-  else if (not_present && f_page->swap_index > -1)
-    swap_in (f_paddr);                              // Swap in
-  else if (is_stack (f, fault_addr))
-    load_stack (f, f_paddr);                        // Grow stack
-  else if (f_page)
-    load_page (spt, f_page);                        // Lazy loading
+    ;                                               // Not ours to resolve
   else
-    thread_exit ();
+    {
+      /* Other threads of the process may fault on the same page or
+         remove it, so hold the fault lock from the lookup until the
+         page is in. */
+      lock_acquire (&spt->fault_lock);
+      f_page = page_find (spt, f_paddr);
+
+      if (not_present && f_page && f_page->frame != NULL)
+        resolved = true;                            // Brought in meanwhile
+      else if (not_present && f_page && f_page->type == PAGE_SWAP)
+        {
+          thread_rusage (thread_current ())->major_faults++;
+          resolved = swap_in (f_page);              // Swap in
+        }
+      else if (not_present && f_page)
+        {
+          if (f_page->type == PAGE_FILE)
+            thread_rusage (thread_current ())->major_faults++;
+          else
+            thread_rusage (thread_current ())->minor_faults++;
+          resolved = load_page (f_page);            // Lazy loading
+          if (resolved && f_page->advice == MADV_SEQUENTIAL)
+            page_stream (spt, f_page);              // Read-ahead, drop-behind
+        }
+      else if (is_stack (user ? f->esp : thread_current ()->user_esp,
+                         fault_addr))
+        {
+          thread_rusage (thread_current ())->minor_faults++;
+          resolved = load_stack (user ? f->esp : thread_current ()->user_esp,
+                                 fault_addr);       // Grow stack
+        }
+      lock_release (&spt->fault_lock);
+      if (resolved)
+        return;
+    }
+
+  /* A bad user address touched by copy_from_user() or
+     copy_to_user().  Only now that the fault is known not to be one
+     we can resolve, resume at the address it left in eax, with eax
+     0 to report the failure. */
+  if (!user && (f->eip == (void (*) (void)) copy_from_user_insn
+                || f->eip == (void (*) (void)) copy_to_user_insn))
+    {
+      f->eip = (void (*) (void)) f->eax;
+      f->eax = 0;
+      return;
+    }
+  thread_exit ();
 }
 
 /*
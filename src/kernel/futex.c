@@ -0,0 +1,229 @@
+#include "kernel/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include "devices/timer.h"
+#include "kernel/interrupt.h"
+#include "kernel/process.h"
+#include "kernel/synch.h"
+#include "kernel/syscall.h"
+#include "kernel/thread.h"
+
+/* Fast user-space mutexes.
+
+   A futex is just an int in user memory.  User code changes it
+   with atomic instructions and only enters the kernel to sleep
+   until the int changes (futex_wait()) or to wake the threads
+   sleeping on it (futex_wake()), so uncontended locking never
+   makes a system call.
+
+   Sleepers wait in a hash table of queues keyed by their address
+   space, which is the same for all threads of a process, and the
+   user address of the int.  Each queue has a lock that both sides
+   hold while they look at the int, so a wakeup cannot slip in
+   between a waiter's check of the int and its going to sleep. */
+
+#define FUTEX_BUCKETS 64
+
+/* A queue of sleepers.  Sleepers for different futexes may share
+   a queue. */
+struct futex_bucket
+  {
+    struct lock lock;           /* Protects WAITERS. */
+    struct list waiters;        /* List of struct futex_waiter. */
+  };
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+/* A thread sleeping in futex_wait(). */
+struct futex_waiter
+  {
+    struct list_elem elem;      /* Element in its bucket's WAITERS. */
+    void *as;                   /* Address space. */
+    int *uaddr;                 /* User address of the futex. */
+    struct thread *thread;      /* The sleeping thread. */
+    bool woken;                 /* Taken off WAITERS by futex_wake()? */
+    bool blocking;              /* In timer_block()? */
+  };
+
+static struct futex_bucket *bucket_for (void *as, int *uaddr);
+static bool wake_waiter (struct futex_waiter *);
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void)
+{
+  int i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    {
+      lock_init (&buckets[i].lock, "futex");
+      list_init (&buckets[i].waiters);
+    }
+}
+
+/* If the int at user address UADDR still holds VAL, sleeps until
+   futex_wake() is called on UADDR or, if TICKS is positive, until
+   TICKS timer ticks pass.  Returns FUTEX_WOKEN, FUTEX_CHANGED if
+   the int did not hold VAL or the process is exiting,
+   FUTEX_TIMEDOUT, or FUTEX_FAULT if UADDR, an aligned user
+   address, is not mapped.
+
+   The int is read with copy_from_user(), so a bad address cannot
+   kill the thread with its queue's lock held.  It is read once
+   without the lock, so that a changed int costs no locking, and
+   again under it. */
+int
+futex_wait (int *uaddr, int val, int64_t ticks)
+{
+  struct futex_waiter w;
+  struct futex_bucket *b;
+  enum intr_level old_level;
+  bool mapped;
+  int cur;
+
+  if (!copy_from_user (&cur, uaddr, sizeof cur))
+    return FUTEX_FAULT;
+  if (cur != val)
+    return FUTEX_CHANGED;
+
+  w.as = process_current ()->spt;
+  w.uaddr = uaddr;
+  w.thread = thread_current ();
+  w.woken = false;
+  w.blocking = false;
+  b = bucket_for (w.as, uaddr);
+
+  lock_acquire (&b->lock);
+  mapped = copy_from_user (&cur, uaddr, sizeof cur);
+  if (!mapped || cur != val || process_exiting ())
+    {
+      lock_release (&b->lock);
+      return mapped ? FUTEX_CHANGED : FUTEX_FAULT;
+    }
+  list_push_back (&b->waiters, &w.elem);
+
+  /* Letting go of the lock may let a waker run before we block,
+     so only block if it has not already been here. */
+  old_level = intr_disable ();
+  lock_release (&b->lock);
+  if (!w.woken)
+    {
+      w.blocking = true;
+      timer_block (ticks);
+      w.blocking = false;
+    }
+  intr_set_level (old_level);
+
+  if (w.woken)
+    return FUTEX_WOKEN;
+
+  /* Timed out.  A waker may still have found us meanwhile. */
+  lock_acquire (&b->lock);
+  if (!w.woken)
+    list_remove (&w.elem);
+  lock_release (&b->lock);
+  return w.woken ? FUTEX_WOKEN : FUTEX_TIMEDOUT;
+}
+
+/* Wakes up to CNT threads of the current process sleeping on the
+   futex at user address UADDR, oldest first.  Returns the number
+   woken. */
+int
+futex_wake (int *uaddr, int cnt)
+{
+  void *as = process_current ()->spt;
+  struct futex_bucket *b = bucket_for (as, uaddr);
+  struct list_elem *e, *next;
+  struct thread *t, *preempt = NULL;
+  int woken = 0;
+
+  lock_acquire (&b->lock);
+  for (e = list_begin (&b->waiters);
+       e != list_end (&b->waiters) && woken < cnt; e = next)
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+      next = list_next (e);
+      if (w->as != as || w->uaddr != uaddr)
+        continue;
+
+      /* W lives on the waiter's stack, which is gone once it runs. */
+      list_remove (e);
+      t = w->thread;
+      if (wake_waiter (w))
+        preempt = t;
+      woken++;
+    }
+  lock_release (&b->lock);
+
+  if (preempt != NULL)
+    thread_preempt (preempt);
+  return woken;
+}
+
+/* Wakes every thread sleeping on a futex in address space AS,
+   whose process is exiting.  process_exiting() keeps them from
+   going back to sleep. */
+void
+futex_cancel (void *as)
+{
+  int i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    {
+      struct futex_bucket *b = &buckets[i];
+      struct list_elem *e, *next;
+
+      lock_acquire (&b->lock);
+      for (e = list_begin (&b->waiters); e != list_end (&b->waiters);
+           e = next)
+        {
+          struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+          next = list_next (e);
+          if (w->as == as)
+            {
+              list_remove (e);
+              wake_waiter (w);
+            }
+        }
+      lock_release (&b->lock);
+    }
+}
+
+/* Marks W, just taken off its bucket's WAITERS, as woken and
+   unblocks its thread if it is asleep.  Returns true if it
+   unblocked the thread.  The bucket's lock must be held.
+
+   The waiter is not blocked yet if it is still on its way to
+   sleep, or no longer if its timeout just passed, and then it may
+   be blocked on something else, such as the bucket's lock.  Either
+   way it sees WOKEN before deciding what to do. */
+static bool
+wake_waiter (struct futex_waiter *w)
+{
+  struct thread *t = w->thread;
+  enum intr_level old_level;
+  bool unblocked = false;
+
+  old_level = intr_disable ();
+  w->woken = true;
+  if (w->blocking && t->status == THREAD_BLOCKED)
+    {
+      timer_cancel (t);
+      thread_unblock (t);
+      unblocked = true;
+    }
+  intr_set_level (old_level);
+  return unblocked;
+}
+
+/* Returns the queue for the futex at UADDR in address space AS. */
+static struct futex_bucket *
+bucket_for (void *as, int *uaddr)
+{
+  unsigned h = hash_int ((uintptr_t) uaddr) ^ hash_int ((uintptr_t) as);
+
+  return &buckets[h % FUTEX_BUCKETS];
+}
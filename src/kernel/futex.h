@@ -0,0 +1,17 @@
+#ifndef KERNEL_FUTEX_H
+#define KERNEL_FUTEX_H
+
+#include <stdint.h>
+
+/* Results of futex_wait(). */
+#define FUTEX_WOKEN 0           /* Woken by futex_wake(). */
+#define FUTEX_CHANGED (-1)      /* The word did not hold the expected value. */
+#define FUTEX_TIMEDOUT (-2)     /* The timeout passed first. */
+#define FUTEX_FAULT (-3)        /* The word is not mapped. */
+
+void futex_init (void);
+int futex_wait (int *uaddr, int val, int64_t ticks);
+int futex_wake (int *uaddr, int cnt);
+void futex_cancel (void *as);
+
+#endif /* kernel/futex.h */
@@ -19,11 +19,14 @@
 #include "kernel/io.h"
 #include "kernel/loader.h"
 #include "kernel/malloc.h"
+#include "kernel/mp.h"
 #include "kernel/palloc.h"
 #include "kernel/pte.h"
 #include "kernel/thread.h"
+#include "kernel/workqueue.h"
 #include "kernel/process.h"
 #include "kernel/exception.h"
+#include "kernel/futex.h"
 #include "kernel/gdt.h"
 #include "kernel/syscall.h"
 #include "kernel/tss.h"
@@ -97,6 +100,7 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  mp_init ();
   ft_init();
   st_init();
 
@@ -114,12 +118,14 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  futex_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  workqueue_init ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -260,6 +266,8 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-lockprof"))
+        lock_profile = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -383,6 +391,7 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -lockprof          Profile lock contention, reported at shutdown.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
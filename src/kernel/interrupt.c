@@ -9,6 +9,10 @@
 #include "kernel/thread.h"
 #include "kernel/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "kernel/gdt.h"
+#include "kernel/process.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -46,6 +50,20 @@ static unsigned int unexpected_cnt[INTR_CNT];
    interrupt returns. */
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
+static uint64_t preempt_cnt;    /* Yields done on interrupt return. */
+
+/* Softirqs raised by external interrupt handlers run as the
+   outermost interrupt returns, with interrupts on, so a further
+   external interrupt may nest inside them.  That interrupt leaves
+   the softirqs it raises, and any yield it asks for, to the
+   interrupt it nests in. */
+static softirq_func *softirq_handlers[SOFTIRQ_CNT];
+static const char *softirq_names[SOFTIRQ_CNT];
+static int softirq_cnt;
+static uint32_t softirq_pending; /* Bit N set if softirq N is raised. */
+static bool in_softirq;         /* Are we running softirqs? */
+
+static void softirq_run (void);
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
@@ -206,12 +224,12 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
   register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt or
+   of softirqs, and false at all other times. */
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  return in_external_intr || in_softirq;
 }
 
 /* During processing of an external interrupt, directs the
@@ -224,6 +242,62 @@ intr_yield_on_return (void)
   ASSERT (intr_context ());
   yield_on_return = true;
 }
+
+/* Returns the number of times an interrupt handler has made the
+   running thread yield as the interrupt returned. */
+uint64_t
+intr_preemptions (void)
+{
+  return preempt_cnt;
+}
+
+/* Registers HANDLER as a new softirq named NAME, for debugging
+   purposes, and returns its number for softirq_raise(). */
+int
+softirq_register (softirq_func *handler, const char *name)
+{
+  ASSERT (softirq_cnt < SOFTIRQ_CNT);
+
+  softirq_handlers[softirq_cnt] = handler;
+  softirq_names[softirq_cnt] = name;
+  return softirq_cnt++;
+}
+
+/* Marks SOFTIRQ to run when the current external interrupt
+   returns.  May only be called by an external interrupt handler
+   or a softirq. */
+void
+softirq_raise (int softirq)
+{
+  ASSERT (intr_context ());
+  ASSERT (softirq >= 0 && softirq < softirq_cnt);
+
+  softirq_pending |= 1u << softirq;
+}
+
+/* Runs the pending softirqs, including any raised meanwhile, with
+   interrupts on.  Interrupts must be off on entry and are off on
+   return. */
+static void
+softirq_run (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  in_softirq = true;
+  while (softirq_pending != 0)
+    {
+      uint32_t pending = softirq_pending;
+      int i;
+
+      softirq_pending = 0;
+      intr_enable ();
+      for (i = 0; i < softirq_cnt; i++)
+        if (pending & (1u << i))
+          softirq_handlers[i] ();
+      intr_disable ();
+    }
+  in_softirq = false;
+}
 
 /* 8259A Programmable Interrupt Controller. */
 
@@ -355,10 +429,11 @@ intr_handler (struct intr_frame *frame)
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
-      ASSERT (!intr_context ());
+      ASSERT (!in_external_intr);
 
       in_external_intr = true;
-      yield_on_return = false;
+      if (!in_softirq)
+        yield_on_return = false;
     }
 
   /* Invoke the interrupt's handler. */
@@ -383,9 +458,29 @@ intr_handler (struct intr_frame *frame)
       in_external_intr = false;
       pic_end_of_interrupt (frame->vec_no); 
 
-      if (yield_on_return) 
-        thread_yield (); 
+      if (!in_softirq)
+        {
+          if (softirq_pending != 0)
+            softirq_run ();
+          if (yield_on_return) 
+            {
+              preempt_cnt++;
+              thread_yield_preempted (); 
+            }
+        }
+    }
+
+#ifdef USERPROG
+  /* A thread whose process's main thread is exiting does not go
+     back to user mode.  Every system call and every timer tick
+     that interrupts user code passes here.  We never return to
+     the interrupted code, so interrupts may go back on. */
+  if (frame->cs == SEL_UCSEG && !intr_context () && process_exiting ())
+    {
+      intr_enable ();
+      thread_exit ();
     }
+#endif
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
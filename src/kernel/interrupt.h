@@ -63,6 +63,16 @@ void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
 bool intr_context (void);
 void intr_yield_on_return (void);
+uint64_t intr_preemptions (void);
+
+/* Softirqs: bottom halves that an external interrupt handler
+   raises and that run as that interrupt returns, after the PIC
+   has been acknowledged and with interrupts back on.  Like
+   interrupt handlers, they may not sleep. */
+#define SOFTIRQ_CNT 8
+typedef void softirq_func (void);
+int softirq_register (softirq_func *, const char *name);
+void softirq_raise (int softirq);
 
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
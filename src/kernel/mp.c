@@ -0,0 +1,218 @@
+#include "kernel/mp.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "kernel/loader.h"
+#include "kernel/vaddr.h"
+
+/* Multiprocessor configuration, from the tables that the BIOS
+   lays out as described in the Intel MultiProcessor
+   Specification, version 1.4.  See [MP] chapter 4.
+
+   The kernel only discovers the other processors for now.  It
+   still runs every thread on the boot processor.  Semaphores,
+   locks and reader-writer locks already guard their state with
+   spinlocks, and a thread that blocks on one cannot be woken until
+   it is off the CPU (see thread_block_unlock()).  Starting the
+   other processors still needs per-CPU GDTs and TSSs, a real-mode
+   trampoline, local APIC timers, per-CPU run queues and idle
+   threads found through the local APIC ID, and a yielding thread
+   kept out of other CPUs' reach until switch_threads() is done
+   with it. */
+
+/* MP floating pointer structure. */
+struct mp_float
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of configuration table. */
+    uint8_t length;             /* Length in 16-byte units, i.e. 1. */
+    uint8_t spec_rev;           /* Specification revision. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    uint8_t type;               /* Default configuration, if nonzero. */
+    uint8_t features[4];        /* Feature bytes. */
+  } __attribute__ ((packed));
+
+/* MP configuration table header. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Length of base table, with header. */
+    uint8_t spec_rev;           /* Specification revision. */
+    uint8_t checksum;           /* Makes base table bytes sum to 0. */
+    char oem[8];                /* OEM identifier. */
+    char product[12];           /* Product identifier. */
+    uint32_t oem_table;         /* Physical address of OEM table. */
+    uint16_t oem_length;        /* Size of OEM table. */
+    uint16_t entry_cnt;         /* Number of entries that follow. */
+    uint32_t lapic;             /* Physical address of local APICs. */
+    uint16_t ext_length;        /* Length of extended entries. */
+    uint8_t ext_checksum;       /* Checksum of extended entries. */
+    uint8_t reserved;
+  } __attribute__ ((packed));
+
+/* Configuration table entry types. */
+#define MP_PROCESSOR 0          /* Processor, 20 bytes. */
+#define MP_IOAPIC 2             /* I/O APIC, 8 bytes. */
+
+/* Processor entry. */
+struct mp_processor
+  {
+    uint8_t type;               /* MP_PROCESSOR. */
+    uint8_t lapic_id;           /* Local APIC ID. */
+    uint8_t lapic_version;      /* Local APIC version. */
+    uint8_t flags;              /* MP_CPU_* bits. */
+    uint32_t signature;         /* CPU type. */
+    uint32_t features;          /* CPUID feature flags. */
+    uint32_t reserved[2];
+  } __attribute__ ((packed));
+
+#define MP_CPU_ENABLED 0x01     /* Processor usable. */
+
+/* I/O APIC entry. */
+struct mp_ioapic
+  {
+    uint8_t type;               /* MP_IOAPIC. */
+    uint8_t id;                 /* I/O APIC ID. */
+    uint8_t version;            /* I/O APIC version. */
+    uint8_t flags;              /* Bit 0 set if usable. */
+    uint32_t addr;              /* Physical address of I/O APIC. */
+  } __attribute__ ((packed));
+
+/* Default local and I/O APIC addresses.  See [MP] 3.6.1. */
+#define LAPIC_DEFAULT 0xfee00000
+#define IOAPIC_DEFAULT 0xfec00000
+
+static size_t cpu_cnt = 1;
+static uint32_t lapic_addr = LAPIC_DEFAULT;
+static uint32_t ioapic_addr = IOAPIC_DEFAULT;
+
+static bool checksum_ok (const void *, size_t);
+static struct mp_float *search (uintptr_t, size_t);
+static struct mp_float *find_float (void);
+
+/* Finds the processors and APICs listed by the BIOS, if it
+   follows the MultiProcessor Specification, and reports them. */
+void
+mp_init (void)
+{
+  struct mp_float *mpf = find_float ();
+  struct mp_config *conf;
+  uint8_t *p, *end;
+  size_t i;
+
+  if (mpf == NULL || mpf->config == 0)
+    {
+      /* No table, or one of the default configurations, which
+         all have two processors but do not say whether both
+         are present. */
+      printf ("mp: no MP configuration table, using 1 CPU.\n");
+      return;
+    }
+  if (mpf->config + sizeof *conf > init_ram_pages * PGSIZE)
+    {
+      printf ("mp: MP configuration table above RAM, using 1 CPU.\n");
+      return;
+    }
+  conf = ptov (mpf->config);
+  if (memcmp (conf->signature, "PCMP", 4)
+      || mpf->config + conf->length > init_ram_pages * PGSIZE
+      || !checksum_ok (conf, conf->length))
+    {
+      printf ("mp: bad MP configuration table, using 1 CPU.\n");
+      return;
+    }
+
+  lapic_addr = conf->lapic;
+  cpu_cnt = 0;
+  p = (uint8_t *) (conf + 1);
+  end = (uint8_t *) conf + conf->length;
+  for (i = 0; i < conf->entry_cnt && p < end; i++)
+    if (*p == MP_PROCESSOR)
+      {
+        struct mp_processor *proc = (struct mp_processor *) p;
+        if ((proc->flags & MP_CPU_ENABLED) && cpu_cnt < CPU_MAX)
+          cpu_cnt++;
+        p += sizeof *proc;
+      }
+    else
+      {
+        /* Every other entry type is 8 bytes long. */
+        if (*p == MP_IOAPIC)
+          ioapic_addr = ((struct mp_ioapic *) p)->addr;
+        p += 8;
+      }
+  if (cpu_cnt == 0)
+    cpu_cnt = 1;
+
+  printf ("mp: %zu CPU%s, local APIC at %#"PRIx32", I/O APIC at %#"PRIx32"; "
+          "running on the boot CPU only.\n",
+          cpu_cnt, cpu_cnt != 1 ? "s" : "", lapic_addr, ioapic_addr);
+}
+
+/* Returns the number of usable processors, up to CPU_MAX. */
+size_t
+mp_cpu_count (void)
+{
+  return cpu_cnt;
+}
+
+/* Returns the physical address of the local APICs. */
+uint32_t
+mp_lapic_addr (void)
+{
+  return lapic_addr;
+}
+
+/* Returns the physical address of the I/O APIC. */
+uint32_t
+mp_ioapic_addr (void)
+{
+  return ioapic_addr;
+}
+
+/* Returns true if the SIZE bytes at P sum to 0 modulo 256. */
+static bool
+checksum_ok (const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Searches the SIZE bytes of physical memory at PADDR for the
+   MP floating pointer structure, which is 16-byte aligned. */
+static struct mp_float *
+search (uintptr_t paddr, size_t size)
+{
+  uint8_t *p = ptov (paddr);
+  uint8_t *end = p + size;
+
+  for (; p + sizeof (struct mp_float) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4) && checksum_ok (p, sizeof (struct mp_float)))
+      return (struct mp_float *) p;
+  return NULL;
+}
+
+/* Finds the MP floating pointer structure in the first kB of the
+   extended BIOS data area, the last kB of base memory, or the
+   BIOS ROM, in that order.  See [MP] 4. */
+static struct mp_float *
+find_float (void)
+{
+  uint16_t ebda = *(uint16_t *) ptov (0x40e);
+  uint16_t base_kb = *(uint16_t *) ptov (0x413);
+  struct mp_float *mpf = NULL;
+
+  if (ebda != 0)
+    mpf = search ((uintptr_t) ebda << 4, 1024);
+  if (mpf == NULL && base_kb != 0)
+    mpf = search ((uintptr_t) base_kb * 1024 - 1024, 1024);
+  if (mpf == NULL)
+    mpf = search (0xf0000, 0x10000);
+  return mpf;
+}
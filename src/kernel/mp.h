@@ -0,0 +1,15 @@
+#ifndef KERNEL_MP_H
+#define KERNEL_MP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Most processors the kernel keeps track of. */
+#define CPU_MAX 8
+
+void mp_init (void);
+size_t mp_cpu_count (void);
+uint32_t mp_lapic_addr (void);
+uint32_t mp_ioapic_addr (void);
+
+#endif /* kernel/mp.h */
@@ -12,11 +12,14 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "kernel/flags.h"
+#include "kernel/futex.h"
 #include "kernel/init.h"
 #include "kernel/interrupt.h"
+#include "kernel/malloc.h"
 #include "kernel/palloc.h"
 #include "kernel/thread.h"
 #include "kernel/vaddr.h"
+#include "kernel/vdso.h"
 #include "kernel/synch.h"
 #include "vm/frame.h"
 #include "vm/page.h"
@@ -24,6 +27,23 @@
 #include "kernel/pte.h"
 
 static thread_func start_process NO_RETURN;
+static thread_func start_thread NO_RETURN;
+static void thread_stack_release (struct thread *);
+
+/* Lowest address of the stacks of a process's extra threads.
+   The shared kernel data page sits just below. */
+#define THREAD_STACKS_BOTTOM \
+  ((uint8_t *) PHYS_BASE - MAX_STACK_SIZE - THREAD_MAX * THREAD_STACK_SIZE)
+
+/* What start_thread() needs to start a new thread of a process. */
+struct thread_start
+  {
+    struct thread *leader;              /* Main thread of the process. */
+    void (*eip) (void);                 /* User code to start at. */
+    void *func;                         /* First argument for EIP. */
+    void *aux;                          /* Second argument for EIP. */
+    uint8_t *stack_top;                 /* Top of the new thread's stack. */
+  };
 static bool load (const char *file_args, void (**eip) (void), void **esp);
 
 /* Starts a new thread running a user program loaded from
@@ -110,6 +130,13 @@ start_process (void *file_args_)
   struct intr_frame if_;
   bool success;
 
+  /* We are the main thread of a new process. */
+  curr->leader = curr;
+  curr->stack_top = PHYS_BASE;
+  curr->stack_size = MAX_STACK_SIZE;
+  sema_init (&curr->threads_done, 0);
+  lock_init (&curr->heap_lock, "heap");
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
@@ -149,45 +176,250 @@ start_process (void *file_args_)
 int
 process_wait (tid_t child_tid)
 {
-  int exit_status = -1;
-  struct thread *curr = thread_current ();
-  struct thread *t;
-  struct list *live_list = &curr->live_children;
-  struct list *zombie_list = &curr->zombie_children;
-  struct list_elem *e;
+  struct child_status *cs = thread_find_child (child_tid);
+  int exit_status;
+
+  if (cs == NULL)
+    return -1;
+
+  sema_down (&cs->exit_sema);
+  exit_status = cs->exit_status;
+  rusage_add (&process_current ()->child_rusage, &cs->rusage);
+  hash_delete (&thread_current ()->children, &cs->elem);
+  child_status_release (cs);
+  return exit_status;
+}
 
-  for (e = list_begin (live_list); e != list_end (live_list); e = list_next (e))
+/* Creates a new thread in the current process, which starts
+   running user code at EIP with FUNC and AUX as its arguments, on
+   a stack of its own.  The new thread shares the process's
+   address space and open files.  Returns the new thread's tid,
+   which its creator may wait for, or TID_ERROR if the process
+   already has THREAD_MAX extra threads or memory is short. */
+tid_t
+process_thread_create (void (*eip) (void), void *func, void *aux)
+{
+  struct thread *leader = process_current ();
+  struct thread_start *start;
+  enum intr_level old_level;
+  tid_t tid;
+  int slot;
+
+  old_level = intr_disable ();
+  for (slot = 0; slot < THREAD_MAX; slot++)
+    if (!(leader->stack_slots & (1u << slot)))
+      break;
+  if (slot < THREAD_MAX)
     {
-      t = list_entry (e, struct thread, child_elem);
-      if (t->tid == child_tid)
-        {
-          sema_down (&t->exit_sema);
-          break;
-        }
+      leader->stack_slots |= 1u << slot;
+      leader->thread_cnt++;
     }
+  intr_set_level (old_level);
+  if (slot == THREAD_MAX)
+    return TID_ERROR;
 
-  for (e = list_begin (zombie_list); e != list_end (zombie_list); e = list_next (e))
+  tid = TID_ERROR;
+  start = malloc (sizeof *start);
+  if (start != NULL)
     {
-      t = list_entry (e, struct thread, child_elem);
-      if (t->tid == child_tid)
-        {
-          exit_status = t->exit_status;
-          list_remove (e);
-          palloc_free_page (t);
-          break;
-        }
+      start->leader = leader;
+      start->eip = eip;
+      start->func = func;
+      start->aux = aux;
+      start->stack_top = (uint8_t *) PHYS_BASE - MAX_STACK_SIZE
+                         - slot * THREAD_STACK_SIZE;
+      tid = thread_create (leader->name, thread_get_priority (),
+                           start_thread, start);
     }
+  if (tid == TID_ERROR)
+    {
+      free (start);
+      old_level = intr_disable ();
+      leader->stack_slots &= ~(1u << slot);
+      leader->thread_cnt--;
+      intr_set_level (old_level);
+    }
+  return tid;
+}
 
-  return exit_status;
+/* A thread function that joins a new thread to the address space
+   of the process in START_ and starts it running user code. */
+static void
+start_thread (void *start_)
+{
+  struct thread *t = thread_current ();
+  struct thread_start *start = start_;
+  struct intr_frame if_;
+  uint32_t *esp;
+
+  t->leader = start->leader;
+  t->pagedir = t->leader->pagedir;
+  t->spt = t->leader->spt;
+  t->stack_top = t->stack_bottom = start->stack_top;
+  t->stack_size = THREAD_STACK_SIZE;
+  t->stack_window = 1;
+  process_activate ();
+
+  /* Map the top page of the stack, then push EIP's two arguments
+     and a null return address, as if EIP had been called. */
+  lock_acquire (&t->spt->fault_lock);
+  load_stack (t->stack_top, t->stack_top - PGSIZE);
+  lock_release (&t->spt->fault_lock);
+  esp = (uint32_t *) t->stack_top;
+  *--esp = (uint32_t) start->aux;
+  *--esp = (uint32_t) start->func;
+  *--esp = 0;
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = start->eip;
+  if_.esp = esp;
+  free (start);
+
+  /* Start the thread as start_process() does. */
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Returns the main thread of the current process, which holds the
+   state that all the process's threads share. */
+struct thread *
+process_current (void)
+{
+  struct thread *t = thread_current ();
+
+  return t->leader != NULL ? t->leader : t;
+}
+
+/* Returns true if the running thread is not its process's main
+   thread and the main thread is exiting.  Such a thread must exit
+   rather than run more user code. */
+bool
+process_exiting (void)
+{
+  struct thread *t = thread_current ();
+
+  return t->leader != NULL && t->leader != t && t->leader->exiting;
+}
+
+/* Keeps the current process's address space from being torn down
+   until process_put() is called, as another running thread of the
+   process would.  For work that kernel threads do on the process's
+   behalf.  Returns the process's main thread. */
+struct thread *
+process_get (void)
+{
+  struct thread *leader = process_current ();
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  leader->thread_cnt++;
+  intr_set_level (old_level);
+  return leader;
+}
+
+/* Drops a reference taken by process_get() on the process whose
+   main thread is LEADER. */
+void
+process_put (struct thread *leader)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  leader->thread_cnt--;
+  intr_set_level (old_level);
+  sema_up (&leader->threads_done);
+}
+
+/* Makes the running kernel thread act for the process whose main
+   thread is LEADER, as if it were one of the process's threads: it
+   uses the process's page directory and SPT and is accounted to the
+   process, until process_leave().  The caller must hold a reference
+   from process_get(). */
+void
+process_enter (struct thread *leader)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->leader == NULL);
+
+  t->leader = leader;
+  t->pagedir = leader->pagedir;
+  t->spt = leader->spt;
+  process_activate ();
+}
+
+/* Undoes process_enter(). */
+void
+process_leave (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->leader != NULL && t->leader != t);
+
+  t->leader = NULL;
+  t->pagedir = NULL;
+  t->spt = NULL;
+  process_activate ();
+}
+
+/* Frees the stack of thread T, which is not its process's main
+   thread, and gives its slot back to the process. */
+static void
+thread_stack_release (struct thread *t)
+{
+  struct thread *leader = t->leader;
+  int slot = ((uint8_t *) PHYS_BASE - MAX_STACK_SIZE - t->stack_top)
+             / THREAD_STACK_SIZE;
+  enum intr_level old_level;
+  struct page *page;
+  uint8_t *upage;
+
+  lock_acquire (&t->spt->fault_lock);
+  for (upage = t->stack_bottom; upage < t->stack_top; upage += PGSIZE)
+    {
+      page = page_find (t->spt, upage);
+      if (page != NULL)
+        remove_page (t->spt, page);
+    }
+  lock_release (&t->spt->fault_lock);
+
+  old_level = intr_disable ();
+  leader->stack_slots &= ~(1u << slot);
+  intr_set_level (old_level);
+  process_put (leader);
 }
 
-/* Free the current process's resources. */
+/* Free the current process's resources.  A thread that is not
+   its process's main thread only frees its stack.  The main
+   thread makes the others exit and waits for them, then tears
+   down the address space.  The others exit the next time they
+   would return to user mode (see intr_handler()), and those
+   asleep on a futex are woken to do so. */
 void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
   uint32_t *pd;
   ASSERT (cur);
+
+  if (cur->leader != NULL && cur->leader != cur)
+    {
+      thread_stack_release (cur);
+      cur->pagedir = NULL;
+      pagedir_activate (NULL);
+      return;
+    }
+  if (cur->leader == cur)
+    {
+      cur->exiting = true;
+      futex_cancel (cur->spt);
+      while (cur->thread_cnt > 0)
+        sema_down (&cur->threads_done);
+    }
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -195,13 +427,10 @@ process_exit (void)
     {
       /* Release process's held locks */
       struct lock *ft = get_ft_lock ();
-      struct lock *spt = &cur->spt->lock;
       struct lock *st = get_st_lock ();
 
       if (lock_held_by_current_thread (ft))
         lock_release (ft);
-      if (lock_held_by_current_thread (spt))
-        lock_release (spt);
       if (lock_held_by_current_thread (st))
         lock_release (st);
 
@@ -217,6 +446,7 @@ process_exit (void)
          that's been freed (and cleared). */
       cur->pagedir = NULL;
       pagedir_activate (NULL);
+      vdso_unmap (pd);
       pagedir_destroy (pd);
     }
 }
@@ -235,6 +465,9 @@ process_activate (void)
   /* Set thread's kernel stack for use in processing
      interrupts. */
   tss_update ();
+
+  /* Let user code see who is running. */
+  vdso_set_thread (t);
 }
 
 /* We load ELF binaries.  The following definitions are taken
@@ -301,6 +534,7 @@ struct Elf32_Phdr
 #define PF_R 4          /* Readable. */
 
 static bool setup_stack (void **esp, const char *file_args);
+static bool fill_page (struct page *, struct frame *);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
@@ -317,6 +551,7 @@ load (const char *file_args, void (**eip) (void), void **esp)
   struct Elf32_Ehdr ehdr;
   struct file *file = NULL;
   off_t file_ofs;
+  uint8_t *heap_start = NULL;
   bool success = false;
   int i;
 
@@ -328,6 +563,12 @@ load (const char *file_args, void (**eip) (void), void **esp)
     goto done;
   process_activate ();
 
+  /* Map the shared kernel data page, which sits between the heap
+     and the threads' stacks. */
+  ASSERT ((uint8_t *) VDSO_ADDR + PGSIZE == THREAD_STACKS_BOTTOM);
+  if (!vdso_map (t->pagedir))
+    goto done;
+
   /* Open executable file. */
   file = filesys_open (&file_args[sizeof (int)]);
 
@@ -403,6 +644,8 @@ load (const char *file_args, void (**eip) (void), void **esp)
               if (!load_segment (file, file_page, (void *) mem_page,
                                  read_bytes, zero_bytes, writable))
                 goto done;
+              if ((uint8_t *) mem_page + read_bytes + zero_bytes > heap_start)
+                heap_start = (uint8_t *) mem_page + read_bytes + zero_bytes;
             }
           else
             goto done;
@@ -410,6 +653,9 @@ load (const char *file_args, void (**eip) (void), void **esp)
         }
     }
 
+  /* The heap starts empty, just past the highest segment. */
+  t->heap_start = t->heap_end = heap_start;
+
   /* Set up stack. */
   if (!setup_stack (esp, file_args))
     goto done;
@@ -512,14 +758,17 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 
     /* Add page to SPT and set initial values */
     struct page *page = add_page (spt, addr);
-    set_page (page, false, false, -1, 1, false, page_zero_bytes, page_read_bytes, 
-      count, PGSIZE, NULL, writable, file, PGSIZE * count);
+    if (page_read_bytes > 0)
+      set_page (page, PAGE_FILE, writable, false, file, ofs + PGSIZE * count,
+                page_read_bytes);
+    else
+      set_page (page, PAGE_ZERO, writable, false, NULL, 0, 0);
     /* Page added and values set. */
 
     /* Advance */
     read_bytes -= page_read_bytes;
     zero_bytes -= page_zero_bytes;
-    addr += page->size;
+    addr += PGSIZE;
   }
 
   return true;
@@ -550,8 +799,13 @@ setup_stack (void **esp, const char *file_args)
     {
       struct spt *spt = thread_current()->spt;
       struct page *page = add_page (spt, addr);
-      set_page (page, true, false, -1, 1, true, 0, 0, 0, PGSIZE, NULL, writable, NULL, 0);
-      set_page_kva (spt, page, frame->addr);
+      /* The arguments are copied in through the kernel mapping, which
+         leaves the user mapping clean, so treat the page as anonymous
+         from the start rather than let eviction drop it. */
+      set_page (page, PAGE_SWAP, writable, true, NULL, 0, 0);
+      set_page_frame (page, frame);
+      thread_current ()->stack_bottom = addr;
+      thread_current ()->stack_window = 1;
 
       /* Extract the TOTAL_BYTES to push initially, and decrement
          ESP by that amount. */
@@ -612,34 +866,126 @@ setup_stack (void **esp, const char *file_args)
   return success;
 }
 
+/* Returns true if a fault at FAULT_ADDR looks like an access to
+   the running thread's stack, given the user stack pointer ESP:
+   it lies within the stack's maximum extent and at most
+   STACK_MARGIN bytes below ESP. */
 bool
-is_stack (struct intr_frame *frame, void *fault_addr)
+is_stack (void *esp, void *fault_addr)
 {
-  return (fault_addr < PHYS_BASE) && (fault_addr >= (frame->esp - STACK_MARGIN));
+  struct thread *t = thread_current ();
+
+  return ((uint8_t *) fault_addr < t->stack_top)
+         && ((uint8_t *) fault_addr >= t->stack_top - t->stack_size)
+         && (fault_addr >= esp - STACK_MARGIN);
 }
 
-void
-load_stack (struct intr_frame *frame, void *f_paddr)
+/* Grows the stack down to FAULT_ADDR, given the user stack
+   pointer ESP.  Every page between the fault and the current
+   bottom of the stack is added, so a large stack object costs one
+   fault.  So is a window below the bottom, which doubles with each
+   growth up to STACK_GROW_PAGES, so that a frame that moved ESP
+   far down takes one fault rather than one per page.  The window
+   stops at the page holding ESP - STACK_MARGIN, the lowest that
+   is_stack() accepts, so nothing below the stack pointer is
+   mapped.  Only the faulting page is certain to get a frame now;
+   the rest take free frames if there are any and are otherwise
+   zero-filled on first touch.  Returns false, without growing the
+   stack, for a fault in the guard region at the bottom of the
+   stack's extent.  The caller must hold the SPT's fault lock. */
+bool
+load_stack (void *esp, void *fault_addr)
 {
-  if(PHYS_BASE - frame->esp >= MAX_STACK_SIZE)
-  {
-    printf ("Max stack size reached.");
-    thread_exit ();
-  }
+  struct thread *t = thread_current ();
+  uint8_t *fault_page = pg_round_down (fault_addr);
+  uint8_t *limit = t->stack_top - t->stack_size + STACK_GUARD_PAGES * PGSIZE;
+  uint8_t *esp_page = pg_round_down ((uint8_t *) esp - STACK_MARGIN);
+  uint8_t *low, *upage;
+  struct page *page;
 
-  bool writable = true;
+  if (fault_page < limit || fault_page >= t->stack_bottom)
+    return false;
+
+  low = t->stack_bottom - t->stack_window * PGSIZE;
+  if (low < esp_page)
+    low = esp_page;
+  if (low > fault_page)
+    low = fault_page;
+  if (low < limit)
+    low = limit;
+  if (t->stack_window < STACK_GROW_PAGES)
+    t->stack_window *= 2;
+
+  for (upage = low; upage < t->stack_bottom; upage += PGSIZE)
+    {
+      page = add_page (t->spt, upage);
+      set_page (page, PAGE_ZERO, true, true, NULL, 0, 0);
+      if (upage == fault_page && !load_page (page))
+        PANIC ("Null page allocated during page fault on address %p.\n",
+               fault_addr);
+    }
+
+  for (upage = t->stack_bottom - PGSIZE; upage >= low; upage -= PGSIZE)
+    if (upage != fault_page)
+      {
+        page = page_find (t->spt, upage);
+        if (!prefetch_page (page))
+          break;
+      }
 
-  struct frame *uframe = allocate_uframe (PAL_USER | PAL_ZERO);
+  t->stack_bottom = low;
+  return true;
+}
 
-  if (!uframe)
-    PANIC ("Null page allocated during page fault on address %p.\n", f_paddr);
+/* Moves the current process's program break by INCREMENT bytes.
+   Pages added to the heap go into the SPT as zero-filled pages,
+   so they only get a frame when first touched; pages given back
+   are released right away.  Returns the old break, or
+   (void *) -1 if the break would leave the heap region, which
+   ends at the shared kernel data page below the stacks. */
+void *
+process_sbrk (intptr_t increment)
+{
+  struct thread *t = process_current ();
+  struct spt *spt = t->spt;
+  uint8_t *old_end, *new_end;
+  uint8_t *upage;
+  struct page *page;
+
+  lock_acquire (&t->heap_lock);
+  old_end = t->heap_end;
+  new_end = old_end + increment;
+  if ((increment > 0 && new_end < old_end)
+      || (increment < 0 && new_end > old_end)
+      || new_end < t->heap_start
+      || new_end > (uint8_t *) VDSO_ADDR)
+    {
+      lock_release (&t->heap_lock);
+      return (void *) -1;
+    }
 
-  struct spt *spt = thread_current()->spt;
-  struct page *page = add_page (spt, f_paddr);
-  set_page (page, true, false, -1, 1, true, 0, 0, 0, PGSIZE, NULL, writable, NULL, 0);
-  set_page_kva (spt, page, uframe->addr);
+  /* Grow. */
+  for (upage = pg_round_up (old_end); upage < (uint8_t *) pg_round_up (new_end);
+       upage += PGSIZE)
+    {
+      page = add_page (spt, upage);
+      set_page (page, PAGE_ZERO, true, false, NULL, 0, 0);
+    }
 
-  ASSERT (install_page (f_paddr, uframe->addr, writable));
+  /* Shrink. */
+  lock_acquire (&spt->fault_lock);
+  for (upage = pg_round_up (new_end); upage < (uint8_t *) pg_round_up (old_end);
+       upage += PGSIZE)
+    {
+      page = page_find (spt, upage);
+      if (page != NULL)
+        remove_page (spt, page);
+    }
+  lock_release (&spt->fault_lock);
+
+  t->heap_end = new_end;
+  lock_release (&t->heap_lock);
+  return old_end;
 }
 
 /*
@@ -656,38 +1002,75 @@ load_stack (struct intr_frame *frame, void *f_paddr)
  *  addr: the address on which the halted process faulted
  */
 bool
-load_page (struct spt *spt, struct page *page)
+load_page (struct page *page)
 {
-  /* Calculate how to fill this page.
-     We will read PAGE_READ_BYTES bytes from FILE
-     and zero the final PAGE_ZERO_BYTES bytes. */
+  /* Get a page of memory, already zeroed if nothing is read into it. */
+  struct frame *frame = allocate_uframe (page->type == PAGE_ZERO
+                                         ? PAL_USER | PAL_ZERO : PAL_USER);
+
+  if (!frame)
+    return false;
+
+  return fill_page (page, frame);
+}
 
-  /* Get a page of memory. */
-  struct frame *frame = allocate_uframe (PAL_USER);
+/*
+ * Function:  prefetch_page 
+ * --------------------
+ *  Like load_page, but only uses a frame that is free right now.  Used for
+ *    read-ahead and MADV_WILLNEED, where evicting a page that is in use to
+ *    load one that may be used would be a bad trade.
+ *
+ *  page: the page to load
+ *
+ *  returns: whether the page was loaded
+ */
+bool
+prefetch_page (struct page *page)
+{
+  struct frame *frame = try_allocate_uframe (page->type == PAGE_ZERO
+                                             ? PAL_USER | PAL_ZERO : PAL_USER);
 
   if (!frame)
     return false;
 
+  return fill_page (page, frame);
+}
+
+/* Fills FRAME with the contents of PAGE and maps it at PAGE's
+   address.  Only PAGE_FILE pages are read; the rest of the page
+   is zeroed.  A PAGE_ZERO page's frame must already be zeroed.
+   Frees FRAME on failure. */
+static bool
+fill_page (struct page *page, struct frame *frame)
+{
+  /* Calculate how to fill this page.
+     We will read PAGE_READ_BYTES bytes from FILE
+     and zero the final PAGE_ZERO_BYTES bytes. */
+
   /* Load this page. */
-  file_seek (page->file, page->ofs);
-  if (file_read (page->file, frame->addr, page->read_bytes) != (int) page->read_bytes)
-  {
-    deallocate_uframe_f (frame);
-    return false; 
-  }
+  if (page->type == PAGE_FILE)
+    {
+      file_seek (page->file, page->ofs);
+      if (file_read (page->file, frame->addr, page->read_bytes) != (int) page->read_bytes)
+        {
+          deallocate_uframe_f (frame);
+          return false; 
+        }
+    }
 
-  memset (frame->addr + page->read_bytes, 0, page->zero_bytes);
+  if (page->type == PAGE_FILE)
+    memset (frame->addr + page->read_bytes, 0, PGSIZE - page->read_bytes);
 
   /* Add the page to the process's address space. */
   if (!install_page (page->addr, frame->addr, page->writable)) 
-  {
-    deallocate_uframe_f (frame);
-    return false; 
-  }
+    {
+      deallocate_uframe_f (frame);
+      return false; 
+    }
 
-  /* Mark the page as loaded and set kv_addr */
-  page->loaded = true;
-  set_page_kva (spt, page, frame->addr);
+  /* Mark the page as resident. */
+  set_page_frame (page, frame);
 
   return true;
 }
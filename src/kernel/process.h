@@ -5,20 +5,40 @@
 #include "kernel/interrupt.h"
 #include "vm/page.h"
 
-static int MAX_STACK_SIZE = 8 * 1024 * 1024;	/* An 8MB maximum stack size */
-static int STACK_MARGIN = 32;					/* A margin of error to be 
+#define MAX_STACK_SIZE (8 * 1024 * 1024)	/* An 8MB maximum stack size */
+#define STACK_MARGIN 32					/* A margin of error to be 
 													used primarily in the 
 													heuristic for stack 
 													growth - the 32 comes from 
 													the size of the PUSHA
 													instruction */
+#define STACK_GUARD_PAGES 16			/* Pages at the bottom of the 
+													stack's extent that are 
+													never mapped, so overflow 
+													faults there */
+#define STACK_GROW_PAGES 16				/* Most pages mapped below the 
+													stack per growth fault */
+#define THREAD_MAX 16					/* Most threads per process 
+													besides the main one */
+#define THREAD_STACK_SIZE (1024 * 1024)	/* Stack extent of each of 
+													those threads, laid out 
+													below the main stack */
 
 tid_t process_execute (const char *cmdline);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
-bool is_stack (struct intr_frame *, void *);
-void load_stack (struct intr_frame *, void *);
-bool load_page (struct spt *, struct page *);
+bool is_stack (void *, void *);
+bool load_stack (void *esp, void *fault_addr);
+bool load_page (struct page *);
+bool prefetch_page (struct page *);
+void *process_sbrk (intptr_t);
+tid_t process_thread_create (void (*eip) (void), void *func, void *aux);
+struct thread *process_current (void);
+bool process_exiting (void);
+struct thread *process_get (void);
+void process_put (struct thread *);
+void process_enter (struct thread *);
+void process_leave (void);
 
 #endif /* kernel/process.h */
@@ -0,0 +1,58 @@
+#ifndef KERNEL_SPINLOCK_H
+#define KERNEL_SPINLOCK_H
+
+#include <debug.h>
+#include <stdbool.h>
+#include "kernel/interrupt.h"
+
+/* A spinlock, for data shared between CPUs that must be touched
+   with interrupts off.  Disabling interrupts is enough on one CPU;
+   a spinlock also keeps other CPUs out.  With a single CPU it is
+   never found held, so it costs one locked exchange. */
+struct spinlock
+  {
+    volatile int locked;        /* 1 if held, 0 if free. */
+  };
+
+/* Initializes LOCK as free. */
+static inline void
+spin_init (struct spinlock *lock)
+{
+  lock->locked = 0;
+}
+
+/* Tries to acquire LOCK without spinning and returns true if
+   successful.  Interrupts must be off. */
+static inline bool
+spin_try_lock (struct spinlock *lock)
+{
+  int old = 1;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* See [IA32-v2b] "XCHG": the exchange is locked implicitly. */
+  asm volatile ("xchgl %0, %1" : "+r" (old), "+m" (lock->locked) : : "memory");
+  return old == 0;
+}
+
+/* Acquires LOCK, spinning until it is free.  Interrupts must be
+   off, so that the holder cannot be preempted on this CPU. */
+static inline void
+spin_lock (struct spinlock *lock)
+{
+  while (!spin_try_lock (lock))
+    while (lock->locked)
+      asm volatile ("pause");
+}
+
+/* Releases LOCK, which the current CPU holds. */
+static inline void
+spin_unlock (struct spinlock *lock)
+{
+  ASSERT (lock->locked);
+
+  asm volatile ("" : : : "memory");
+  lock->locked = 0;
+}
+
+#endif /* kernel/spinlock.h */
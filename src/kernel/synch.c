@@ -31,6 +31,54 @@
 #include <string.h>
 #include "kernel/interrupt.h"
 #include "kernel/thread.h"
+#include "devices/timer.h"
+
+/* How many lock holders a donation is passed along, so that a
+   long or circular chain of waiters cannot stall the donor. */
+#define DONATION_DEPTH 8
+
+/* Serializes priority donation, which walks from lock to holder
+   to the lock that holder waits for, and so on.  Taken before any
+   semaphore's spinlock, which is taken before a run queue's. */
+static struct spinlock donation_lock;
+
+static void lock_take (struct lock *);
+
+/* Contention profile of all the locks initialized with one name.
+   Times are in nanoseconds. */
+struct lock_stats
+  {
+    const char *name;           /* Name given to lock_init(). */
+    int64_t acquires;           /* Times acquired. */
+    int64_t contended;          /* Acquires that found the lock held. */
+    int64_t wait_ns;            /* Total time spent waiting to acquire. */
+    int64_t max_wait_ns;        /* Longest wait. */
+    int64_t hold_ns;            /* Total time held. */
+    int64_t max_hold_ns;        /* Longest hold. */
+
+    /* Threads that held the lock longest, by thread name.  When
+       a new thread outholds the least of these, it replaces it, so
+       the list is approximate once more threads than this hold
+       the lock. */
+    struct
+      {
+        char name[16];          /* Thread name. */
+        int64_t hold_ns;        /* Total time held by that thread. */
+      }
+    holders[3];
+  };
+
+/* Profiles for up to LOCK_STATS_MAX distinct lock names.  Locks
+   named after the table fills up are not profiled. */
+#define LOCK_STATS_MAX 32
+static struct lock_stats lock_stats[LOCK_STATS_MAX];
+static int lock_stats_cnt;
+
+bool lock_profile;
+
+static struct lock_stats *lock_stats_get (const char *name);
+static void lock_stats_acquired (struct lock *, int64_t start, bool contended);
+static void lock_stats_released (struct lock *);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -46,6 +94,7 @@ sema_init (struct semaphore *sema, unsigned value)
 {
   ASSERT (sema != NULL);
 
+  spin_init (&sema->lock);
   sema->value = value;
   list_init (&sema->waiters);
 }
@@ -66,12 +115,15 @@ sema_down (struct semaphore *sema)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+  spin_lock (&sema->lock);
   while (sema->value == 0) 
     {
       list_push_back (&sema->waiters, &thread_current ()->elem);
-      thread_block ();
+      thread_block_unlock (&sema->lock);
+      spin_lock (&sema->lock);
     }
   sema->value--;
+  spin_unlock (&sema->lock);
   intr_set_level (old_level);
 }
 
@@ -89,6 +141,7 @@ sema_try_down (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
+  spin_lock (&sema->lock);
   if (sema->value > 0) 
     {
       sema->value--;
@@ -96,28 +149,43 @@ sema_try_down (struct semaphore *sema)
     }
   else
     success = false;
+  spin_unlock (&sema->lock);
   intr_set_level (old_level);
 
   return success;
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any, yielding to it if it outranks the running thread.
 
    This function may be called from an interrupt handler. */
 void
 sema_up (struct semaphore *sema) 
 {
   enum intr_level old_level;
+  struct thread *t = NULL;
 
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
+  spin_lock (&sema->lock);
   if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      /* Priorities may have changed through donation since the
+         waiters queued, so search rather than keep them sorted. */
+      struct list_elem *e = list_min (&sema->waiters, thread_priority_more,
+                                      NULL);
+      list_remove (e);
+      t = list_entry (e, struct thread, elem);
+      thread_unblock (t);
+    }
   sema->value++;
+  spin_unlock (&sema->lock);
   intr_set_level (old_level);
+
+  if (t != NULL)
+    thread_preempt (t);
 }
 
 static void sema_test_helper (void *sema_);
@@ -171,13 +239,19 @@ sema_test_helper (void *sema_)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   NAME identifies LOCK in the contention profile, which adds up
+   all the locks with the same name. */
 void
-lock_init (struct lock *lock)
+lock_init (struct lock *lock, const char *name)
 {
   ASSERT (lock != NULL);
+  ASSERT (name != NULL);
 
   lock->holder = NULL;
+  lock->priority = PRI_MIN;
+  lock->stats = lock_profile ? lock_stats_get (name) : NULL;
   sema_init (&lock->semaphore, 1);
 }
 
@@ -188,16 +262,56 @@ lock_init (struct lock *lock)
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
-   we need to sleep. */
+   we need to sleep.
+
+   While it waits, the current thread donates its priority to the
+   holder of LOCK, and on to the holder of the lock that thread
+   waits for, up to DONATION_DEPTH holders deep. */
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  struct lock *l;
+  int64_t start = 0;
+  bool contended;
+  int depth;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  if (lock->stats != NULL)
+    start = timer_ns ();
+
+  old_level = intr_disable ();
+  spin_lock (&donation_lock);
+  contended = lock->holder != NULL;
+  if (contended && !thread_mlfqs)
+    {
+      cur->waiting_lock = lock;
+      for (l = lock, depth = 0; l != NULL && depth < DONATION_DEPTH;
+           l = l->holder->waiting_lock, depth++)
+        {
+          if (l->priority < cur->priority)
+            l->priority = cur->priority;
+          if (l->holder == NULL || l->holder->priority >= cur->priority)
+            break;
+          thread_donate_priority (l->holder, cur->priority);
+        }
+    }
+  spin_unlock (&donation_lock);
+
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  spin_lock (&donation_lock);
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  lock_take (lock);
+  spin_unlock (&donation_lock);
+  intr_set_level (old_level);
+
+  if (lock->stats != NULL)
+    lock_stats_acquired (lock, start, contended);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -216,7 +330,17 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      enum intr_level old_level = intr_disable ();
+      spin_lock (&donation_lock);
+      lock->holder = thread_current ();
+      lock_take (lock);
+      spin_unlock (&donation_lock);
+      intr_set_level (old_level);
+
+      if (lock->stats != NULL)
+        lock_stats_acquired (lock, timer_ns (), false);
+    }
   return success;
 }
 
@@ -228,13 +352,52 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  if (lock->stats != NULL)
+    lock_stats_released (lock);
+
+  /* Give back what was donated through LOCK before waking the
+     next holder, which sema_up() then yields to if it should. */
+  old_level = intr_disable ();
+  spin_lock (&donation_lock);
+  list_remove (&lock->elem);
   lock->holder = NULL;
+  lock->priority = PRI_MIN;
+  thread_refresh_priority (thread_current ());
+  spin_unlock (&donation_lock);
+  intr_set_level (old_level);
+
   sema_up (&lock->semaphore);
 }
 
+/* Records that LOCK's new holder holds it, and sets the priority
+   donated through LOCK to that of its highest-priority remaining
+   waiter, which the holder takes on.  Interrupts must be off and
+   donation_lock held. */
+static void
+lock_take (struct lock *lock)
+{
+  struct list *waiters = &lock->semaphore.waiters;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (&lock->holder->held_locks, &lock->elem);
+  lock->priority = PRI_MIN;
+  spin_lock (&lock->semaphore.lock);
+  if (!list_empty (waiters) && !thread_mlfqs)
+    {
+      struct thread *t = list_entry (list_min (waiters, thread_priority_more,
+                                               NULL), struct thread, elem);
+      lock->priority = t->priority;
+      thread_donate_priority (lock->holder, t->priority);
+    }
+  spin_unlock (&lock->semaphore.lock);
+}
+
 /* Returns true if the current thread holds LOCK, false
    otherwise.  (Note that testing whether some other thread holds
    a lock would be racy.) */
@@ -245,14 +408,125 @@ lock_held_by_current_thread (const struct lock *lock)
 
   return lock->holder == thread_current ();
 }
+
+/* Returns the profile for locks named NAME, creating it if
+   necessary, or a null pointer if the table is full. */
+static struct lock_stats *
+lock_stats_get (const char *name)
+{
+  struct lock_stats *s = NULL;
+  enum intr_level old_level;
+  int i;
+
+  old_level = intr_disable ();
+  for (i = 0; i < lock_stats_cnt; i++)
+    if (!strcmp (lock_stats[i].name, name))
+      {
+        s = &lock_stats[i];
+        break;
+      }
+  if (s == NULL && lock_stats_cnt < LOCK_STATS_MAX)
+    {
+      s = &lock_stats[lock_stats_cnt++];
+      s->name = name;
+    }
+  intr_set_level (old_level);
+
+  return s;
+}
+
+/* Records that the current thread acquired LOCK after starting
+   to try at time START. */
+static void
+lock_stats_acquired (struct lock *lock, int64_t start, bool contended)
+{
+  struct lock_stats *s = lock->stats;
+  int64_t now = timer_ns ();
+  int64_t wait = now - start;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  s->acquires++;
+  if (contended)
+    s->contended++;
+  s->wait_ns += wait;
+  if (wait > s->max_wait_ns)
+    s->max_wait_ns = wait;
+  intr_set_level (old_level);
+
+  lock->acquired_ns = now;
+}
+
+/* Records that the current thread is about to release LOCK. */
+static void
+lock_stats_released (struct lock *lock)
+{
+  struct lock_stats *s = lock->stats;
+  const char *name = thread_name ();
+  int64_t hold = timer_ns () - lock->acquired_ns;
+  enum intr_level old_level;
+  size_t i, least = 0;
+
+  old_level = intr_disable ();
+  s->hold_ns += hold;
+  if (hold > s->max_hold_ns)
+    s->max_hold_ns = hold;
+
+  for (i = 0; i < sizeof s->holders / sizeof *s->holders; i++)
+    {
+      if (!strcmp (s->holders[i].name, name))
+        break;
+      if (s->holders[i].hold_ns < s->holders[least].hold_ns)
+        least = i;
+    }
+  if (i < sizeof s->holders / sizeof *s->holders)
+    s->holders[i].hold_ns += hold;
+  else if (hold > s->holders[least].hold_ns)
+    {
+      strlcpy (s->holders[least].name, name, sizeof s->holders[least].name);
+      s->holders[least].hold_ns = hold;
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints the contention profile of each lock name, if lock
+   profiling is on.  Times are in microseconds. */
+void
+lock_print_stats (void)
+{
+  int i;
+
+  if (!lock_profile)
+    return;
+
+  for (i = 0; i < lock_stats_cnt; i++)
+    {
+      const struct lock_stats *s = &lock_stats[i];
+      size_t j;
+
+      printf ("Lock %s: %lld acquires, %lld contended, "
+              "wait %lld us (max %lld), hold %lld us (max %lld)\n",
+              s->name, s->acquires, s->contended,
+              s->wait_ns / 1000, s->max_wait_ns / 1000,
+              s->hold_ns / 1000, s->max_hold_ns / 1000);
+      for (j = 0; j < sizeof s->holders / sizeof *s->holders; j++)
+        if (s->holders[j].name[0] != '\0')
+          printf ("  held by %s: %lld us\n",
+                  s->holders[j].name, s->holders[j].hold_ns / 1000);
+    }
+}
 
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
+static bool waiter_priority_more (const struct list_elem *,
+                                  const struct list_elem *, void *aux);
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -295,6 +569,7 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
@@ -302,7 +577,8 @@ cond_wait (struct condition *cond, struct lock *lock)
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
+   this function signals the highest-priority one to wake up from
+   its wait.
    LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -317,8 +593,24 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      struct list_elem *e = list_min (&cond->waiters, waiter_priority_more,
+                                      NULL);
+      list_remove (e);
+      sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+    }
+}
+
+/* Orders condition variable waiters by the priority of their
+   threads, highest first. */
+static bool
+waiter_priority_more (const struct list_elem *a_, const struct list_elem *b_,
+                      void *aux UNUSED)
+{
+  const struct semaphore_elem *a = list_entry (a_, struct semaphore_elem, elem);
+  const struct semaphore_elem *b = list_entry (b_, struct semaphore_elem, elem);
+
+  return a->thread->priority > b->thread->priority;
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -336,3 +628,147 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RWLOCK, which starts out held by nobody. */
+void
+rwlock_init (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  spin_init (&rwlock->lock);
+  rwlock->readers = 0;
+  rwlock->writer = NULL;
+  rwlock->waiting_writers = 0;
+  list_init (&rwlock->read_waiters);
+  list_init (&rwlock->write_waiters);
+}
+
+/* Acquires RWLOCK for reading, sleeping while a writer holds it
+   or waits for it.  When no writer is around, which is the common
+   case, this only bumps a counter.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rwlock->writer != thread_current ());
+
+  old_level = intr_disable ();
+  spin_lock (&rwlock->lock);
+  while (rwlock->writer != NULL || rwlock->waiting_writers > 0)
+    {
+      list_push_back (&rwlock->read_waiters, &thread_current ()->elem);
+      thread_block_unlock (&rwlock->lock);
+      spin_lock (&rwlock->lock);
+    }
+  rwlock->readers++;
+  spin_unlock (&rwlock->lock);
+  intr_set_level (old_level);
+}
+
+/* Releases RWLOCK, which the current thread holds for reading.
+   The last reader out lets a waiting writer in. */
+void
+rwlock_release_read (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+  struct thread *t = NULL;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (rwlock->readers > 0);
+
+  old_level = intr_disable ();
+  spin_lock (&rwlock->lock);
+  if (--rwlock->readers == 0 && !list_empty (&rwlock->write_waiters))
+    {
+      t = list_entry (list_pop_front (&rwlock->write_waiters),
+                      struct thread, elem);
+      thread_unblock (t);
+    }
+  spin_unlock (&rwlock->lock);
+  intr_set_level (old_level);
+
+  if (t != NULL)
+    thread_preempt (t);
+}
+
+/* Acquires RWLOCK for writing, sleeping until no reader or other
+   writer holds it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_for_write (rwlock));
+
+  old_level = intr_disable ();
+  spin_lock (&rwlock->lock);
+  rwlock->waiting_writers++;
+  while (rwlock->writer != NULL || rwlock->readers > 0)
+    {
+      list_push_back (&rwlock->write_waiters, &thread_current ()->elem);
+      thread_block_unlock (&rwlock->lock);
+      spin_lock (&rwlock->lock);
+    }
+  rwlock->waiting_writers--;
+  rwlock->writer = thread_current ();
+  spin_unlock (&rwlock->lock);
+  intr_set_level (old_level);
+}
+
+/* Releases RWLOCK, which the current thread holds for writing.
+   Hands it to the next waiting writer if there is one, otherwise
+   wakes all waiting readers. */
+void
+rwlock_release_write (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+  struct thread *best = NULL;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (rwlock_held_for_write (rwlock));
+
+  old_level = intr_disable ();
+  spin_lock (&rwlock->lock);
+  rwlock->writer = NULL;
+  if (!list_empty (&rwlock->write_waiters))
+    {
+      best = list_entry (list_pop_front (&rwlock->write_waiters),
+                         struct thread, elem);
+      thread_unblock (best);
+    }
+  else
+    while (!list_empty (&rwlock->read_waiters))
+      {
+        struct thread *t = list_entry (list_pop_front (&rwlock->read_waiters),
+                                       struct thread, elem);
+        thread_unblock (t);
+        if (best == NULL || t->priority > best->priority)
+          best = t;
+      }
+  spin_unlock (&rwlock->lock);
+  intr_set_level (old_level);
+
+  if (best != NULL)
+    thread_preempt (best);
+}
+
+/* Returns true if the current thread holds RWLOCK for writing,
+   false otherwise.  (Readers are not tracked individually.) */
+bool
+rwlock_held_for_write (const struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  return rwlock->writer == thread_current ();
+}
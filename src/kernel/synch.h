@@ -3,10 +3,13 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "kernel/spinlock.h"
 
 /* A counting semaphore. */
 struct semaphore 
   {
+    struct spinlock lock;       /* Protects VALUE and WAITERS. */
     unsigned value;             /* Current value. */
     struct list waiters;        /* List of waiting threads. */
   };
@@ -22,13 +25,23 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks list. */
+    int priority;               /* Highest priority donated through lock. */
+    struct lock_stats *stats;   /* Contention profile, if profiling. */
+    int64_t acquired_ns;        /* When the holder acquired it, if profiling. */
   };
 
-void lock_init (struct lock *);
+/* If true, profile contention for every lock, per name given to
+   lock_init().  Controlled by kernel command-line option
+   "-lockprof". */
+extern bool lock_profile;
+
+void lock_init (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_print_stats (void);
 
 /* Condition variable. */
 struct condition 
@@ -41,6 +54,27 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Reader-writer lock.  Any number of readers or a single writer
+   may hold it.  Waiting writers keep new readers out, so writers
+   do not starve.  Unlike struct lock, it does not donate
+   priority. */
+struct rwlock
+  {
+    struct spinlock lock;       /* Protects the other members. */
+    int readers;                /* Number of readers holding the lock. */
+    struct thread *writer;      /* Writer holding the lock, if any. */
+    int waiting_writers;        /* Writers waiting to acquire. */
+    struct list read_waiters;   /* Threads waiting to read. */
+    struct list write_waiters;  /* Threads waiting to write. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
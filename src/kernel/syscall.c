@@ -2,6 +2,7 @@
 #include "kernel/pagedir.h"
 #include "kernel/process.h"
 #include "kernel/exception.h"
+#include "kernel/futex.h"
 #include <stdio.h>
 #include <stdbool.h>
 #include <syscall-nr.h>
@@ -11,6 +12,7 @@
 #include "kernel/vaddr.h"
 #include "devices/input.h"
 #include "devices/shutdown.h"
+#include "devices/timer.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "vm/page.h"
@@ -24,70 +26,162 @@ syscall_init (void)
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
+/* A system call handler.  ARGS holds the call's argument words,
+   already copied in from the user stack. */
+typedef void syscall_func (struct intr_frame *f, const uint32_t *args);
+
 bool is_valid_ptr (void *ptr, struct intr_frame *);
-void halt (struct intr_frame *f);
-void exit (struct intr_frame *f);
-void exec (struct intr_frame *f);
-void wait (struct intr_frame *f);
-void create (struct intr_frame *f);
-void remove (struct intr_frame *f);
-void open (struct intr_frame *f);
-void filesize (struct intr_frame *f);
-void read (struct intr_frame *f);
-void write (struct intr_frame *f);
-void seek (struct intr_frame *f);
-void tell (struct intr_frame *f);
-void close (struct intr_frame *f);
+void halt (struct intr_frame *f, const uint32_t *args);
+void exit (struct intr_frame *f, const uint32_t *args);
+void exec (struct intr_frame *f, const uint32_t *args);
+void wait (struct intr_frame *f, const uint32_t *args);
+void create (struct intr_frame *f, const uint32_t *args);
+void remove (struct intr_frame *f, const uint32_t *args);
+void open (struct intr_frame *f, const uint32_t *args);
+void filesize (struct intr_frame *f, const uint32_t *args);
+void read (struct intr_frame *f, const uint32_t *args);
+void write (struct intr_frame *f, const uint32_t *args);
+void seek (struct intr_frame *f, const uint32_t *args);
+void tell (struct intr_frame *f, const uint32_t *args);
+void close (struct intr_frame *f, const uint32_t *args);
+void madvise (struct intr_frame *f, const uint32_t *args);
+void mlock (struct intr_frame *f, const uint32_t *args);
+void munlock (struct intr_frame *f, const uint32_t *args);
+void sbrk (struct intr_frame *f, const uint32_t *args);
+void clock_ns (struct intr_frame *f, const uint32_t *args);
+void uthread_create (struct intr_frame *f, const uint32_t *args);
+void uthread_join (struct intr_frame *f, const uint32_t *args);
+void futex (struct intr_frame *f, const uint32_t *args);
+void sched_stats (struct intr_frame *f, const uint32_t *args);
+void getrusage (struct intr_frame *f, const uint32_t *args);
+void sched_setrt (struct intr_frame *f, const uint32_t *args);
+void sched_rt_yield (struct intr_frame *f, const uint32_t *args);
+
+/* Most argument words any system call takes. */
+#define SYSCALL_ARGS_MAX 4
+
+/* A system call's handler and the number of argument words it
+   takes from the user stack. */
+struct syscall
+  {
+    syscall_func *func;
+    int arg_cnt;
+  };
+
+/* System calls, by number.  Numbers without a handler, such as
+   those of unimplemented projects, fail with -1. */
+static const struct syscall syscalls[] =
+  {
+    [SYS_HALT] = {halt, 0},             /* Halt the operating system. */
+    [SYS_EXIT] = {exit, 1},             /* Terminate this process. */
+    [SYS_EXEC] = {exec, 1},             /* Start another process. */
+    [SYS_WAIT] = {wait, 1},             /* Wait for a child process to die. */
+    [SYS_CREATE] = {create, 2},         /* Create a file. */
+    [SYS_REMOVE] = {remove, 1},         /* Delete a file. */
+    [SYS_OPEN] = {open, 1},             /* Open a file. */
+    [SYS_FILESIZE] = {filesize, 1},     /* Obtain a file's size. */
+    [SYS_READ] = {read, 3},             /* Read from a file. */
+    [SYS_WRITE] = {write, 3},           /* Write to a file. */
+    [SYS_SEEK] = {seek, 2},             /* Change position in a file. */
+    [SYS_TELL] = {tell, 1},             /* Report current position in a file. */
+    [SYS_CLOSE] = {close, 1},           /* Close a file. */
+    [SYS_MADVISE] = {madvise, 3},       /* Give the VM a hint about a range. */
+    [SYS_MLOCK] = {mlock, 2},           /* Fault in and pin a range. */
+    [SYS_MUNLOCK] = {munlock, 2},       /* Unpin a range. */
+    [SYS_SBRK] = {sbrk, 1},             /* Move the end of the heap. */
+    [SYS_CLOCK_NS] = {clock_ns, 1},     /* Read the nanosecond clock. */
+    [SYS_THREAD_CREATE] = {uthread_create, 3}, /* Start a thread in this process. */
+    [SYS_THREAD_JOIN] = {uthread_join, 1},     /* Wait for a thread to exit. */
+    [SYS_FUTEX] = {futex, 4},           /* Sleep on or wake a user-space int. */
+    [SYS_SCHED_STATS] = {sched_stats, 1}, /* Read scheduler measurements. */
+    [SYS_GETRUSAGE] = {getrusage, 2},   /* Read resource usage. */
+    [SYS_SCHED_SETRT] = {sched_setrt, 2}, /* Join or leave the real-time class. */
+    [SYS_SCHED_RT_YIELD] = {sched_rt_yield, 0}, /* Wait for the next period. */
+  };
+#define SYSCALL_CNT ((int) (sizeof syscalls / sizeof *syscalls))
 
 static void
 syscall_handler (struct intr_frame *f) 
 {
-  int *syscall_num = (int *) (f->esp);
-  if (!is_valid_ptr ((void *) syscall_num, f))
-    thread_exit ();
+  uint32_t args[SYSCALL_ARGS_MAX];
+  const struct syscall *sc;
+  int nr;
+
+  /* Page faults taken inside the kernel do not save the user's esp,
+     so keep it for the stack-growth heuristic. */
+  thread_current ()->user_esp = f->esp;
 
-  switch (*syscall_num)
+  if (!copy_from_user (&nr, f->esp, sizeof nr))
+    thread_exit ();
+  if (nr < 0 || nr >= SYSCALL_CNT || syscalls[nr].func == NULL)
     {
-      case SYS_HALT:        /* Halt the operating system. */
-        halt (f);
-        break;
-      case SYS_EXIT:        /* Terminate this process. */
-        exit (f);
-        break;
-      case SYS_EXEC:        /* Start another process. */
-        exec (f);
-        break;
-      case SYS_WAIT:        /* Wait for a child process to die. */
-        wait (f);
-        break;
-      case SYS_CREATE:      /* Create a file. */
-        create (f);
-        break;
-      case SYS_REMOVE:      /* Delete a file. */
-        remove (f);
-        break;
-      case SYS_OPEN:        /* Open a file. */
-        open (f);
-        break;
-      case SYS_FILESIZE:    /* Obtain a file's size. */
-        filesize (f);
-        break;
-      case SYS_READ:        /* Read from a file. */
-        read (f);
-        break;
-      case SYS_WRITE:       /* Write to a file. */
-        write (f);
-        break;
-      case SYS_SEEK:        /* Change position in a file. */
-        seek (f);
-        break;
-      case SYS_TELL:        /* Report current position in a file. */
-        tell (f);
-        break;
-      case SYS_CLOSE:       /* Close a file. */
-        close (f);
-        break;
+      f->eax = -1;
+      return;
     }
+
+  sc = &syscalls[nr];
+  ASSERT (sc->arg_cnt <= SYSCALL_ARGS_MAX);
+  if (!copy_from_user (args, (uint32_t *) f->esp + 1,
+                       sc->arg_cnt * sizeof *args))
+    thread_exit ();
+  sc->func (f, args);
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address DST.
+   Returns true if successful, false if any of the user bytes is
+   not mapped into the process.
+
+   The whole copy is one REP MOVSB.  Pages that are merely not
+   resident are faulted in as usual.  If a byte is truly bad,
+   page_fault() sees the fault at copy_from_user_insn and resumes
+   at the address we left in EAX, with EAX set to 0. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  const uint8_t *src = usrc;
+  int ok;
+
+  if (size == 0)
+    return true;
+  if (src + size < src || !is_user_vaddr (src + size - 1))
+    return false;
+
+  asm volatile ("movl $1f, %%eax\n"
+                ".globl copy_from_user_insn\n"
+                "copy_from_user_insn:\n\t"
+                "rep movsb\n\t"
+                "movl $1, %%eax\n"
+                "1:"
+                : "=&a" (ok), "+S" (src), "+D" (dst), "+c" (size)
+                : : "memory");
+  return ok;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address UDST.
+   Returns true if successful, false if any of the user bytes is
+   not mapped writable into the process.  Works as
+   copy_from_user() does, with copy_to_user_insn as the
+   instruction that may fault. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  uint8_t *dst = udst;
+  int ok;
+
+  if (size == 0)
+    return true;
+  if (dst + size < dst || !is_user_vaddr (dst + size - 1))
+    return false;
+
+  asm volatile ("movl $1f, %%eax\n"
+                ".globl copy_to_user_insn\n"
+                "copy_to_user_insn:\n\t"
+                "rep movsb\n\t"
+                "movl $1, %%eax\n"
+                "1:"
+                : "=&a" (ok), "+S" (src), "+D" (dst), "+c" (size)
+                : : "memory");
+  return ok;
 }
 
 /* Checks if a pointer is valid by making sure the pointer isn't NULL, is within the user memory, and mapped to a existing page. */
@@ -98,111 +192,89 @@ is_valid_ptr (void *ptr, struct intr_frame *f UNUSED)
     return false;
   if (!is_user_vaddr (ptr))
     return false;
-  if (page_lookup (&thread_current()->spt->table, pg_round_down (ptr)) && 
-        !pagedir_get_page (thread_current ()->pagedir, ptr))  // Page is not resident but is in SPT
-      swap_in (pg_round_down (ptr)); // Process as PF to load page (non-write)
+  struct spt *spt = thread_current ()->spt;
+  lock_acquire (&spt->fault_lock);
+  struct page *page = page_find (spt, pg_round_down (ptr));
+  if (page && !pagedir_get_page (thread_current ()->pagedir, ptr))  // Page is not resident but is in SPT
+      page_in (page); // Process as PF to load page (non-write)
+  lock_release (&spt->fault_lock);
   return true;
 }
 
 /* Calls shutdown_power_off which terminates the kernal. */
 void
-halt (struct intr_frame *f)
+halt (struct intr_frame *f UNUSED, const uint32_t *args UNUSED)
 {
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_HALT);
-
   shutdown_power_off ();
 }
 
 
 /* Exits a process (thread) with the given exit status. */
 void
-exit (struct intr_frame *f)
+exit (struct intr_frame *f UNUSED, const uint32_t *args)
 {
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_EXIT);
-
-  int *exit_status = syscall_num + 1;
-  if (is_valid_ptr ((void *) exit_status,f ))
-    thread_current ()->exit_status = *exit_status;
-
+  thread_current ()->exit_status = (int) args[0];
   thread_exit ();
 }
 
 /* Executes the process by forking a child process (thread) which will load the proper executable. 
     Returns the PID (TID) of the child if it was loaded successfully otherwise, -1. */
 void
-exec (struct intr_frame *f)
+exec (struct intr_frame *f, const uint32_t *args)
 {
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_EXEC);
-
-  char **cmdline = (char **) (syscall_num + 1);
-  if (!is_valid_ptr ((void *) cmdline, f) ||
-      !is_valid_ptr ((void *) *cmdline, f))
+  char *cmdline = (char *) args[0];
+  if (!is_valid_ptr ((void *) cmdline, f))
     thread_exit ();
 
-  int pid = process_execute (*cmdline);
+  int pid = process_execute (cmdline);
   f->eax = thread_current ()->exec_child_success ? pid : TID_ERROR;
 }
 
 /* Causes the parent thread to wait for a specified child until it finishes it's execution and reaps a zombie child. 
     Returns exit status of the reaped child.*/
 void
-wait (struct intr_frame *f)
+wait (struct intr_frame *f, const uint32_t *args)
 {
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_WAIT);
+  tid_t child_tid = (tid_t) args[0];
 
-  tid_t *child_tid = (tid_t *) (syscall_num + 1);
-  if (!is_valid_ptr ((void *) child_tid, f))
-    thread_exit ();
-
-  f->eax = process_wait (*child_tid);
+  f->eax = process_wait (child_tid);
 }
 
 
 /* Creates a file given the specified size and name. 
     Returns whether the creation of the file was successful or not.*/
 void
-create (struct intr_frame *f)
+create (struct intr_frame *f, const uint32_t *args)
 {
+  char *name = (char *) args[0];
+  unsigned initial_size = args[1];
+
   lock_acquire (&thread_filesys_lock);
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_CREATE);
-
-  char **name = (char **) (syscall_num + 1);
-  unsigned *initial_size = (unsigned *) (syscall_num + 2);
-  if (!is_valid_ptr ((void *) name, f) ||
-      !is_valid_ptr ((void *) *name, f) ||
-      !is_valid_ptr ((void *) initial_size, f))
+  if (!is_valid_ptr ((void *) name, f))
     {
       lock_release (&thread_filesys_lock);
       thread_exit ();
     }
 
-  f->eax = filesys_create (*name, *initial_size);
+  f->eax = filesys_create (name, initial_size);
   lock_release (&thread_filesys_lock);
 }
 
 /* Removes a file given a file name.
     Returns whether the deletion of a file is successful or not. */
 void
-remove (struct intr_frame *f)
+remove (struct intr_frame *f, const uint32_t *args)
 {
-  lock_acquire (&thread_filesys_lock);
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_REMOVE);
+  char *name = (char *) args[0];
 
-  char **name = (char **) (syscall_num + 1);
-  if (!is_valid_ptr ((void *) name, f) ||
-      !is_valid_ptr ((void *) *name, f))
+  lock_acquire (&thread_filesys_lock);
+  if (!is_valid_ptr ((void *) name, f))
     {
       lock_release (&thread_filesys_lock);
       thread_exit ();
     }
 
-  f->eax = filesys_remove (*name);
+  f->eax = filesys_remove (name);
   lock_release (&thread_filesys_lock);
 }
 
@@ -210,21 +282,18 @@ remove (struct intr_frame *f)
     first open slot in open_files array within the current thread. 
     Returns file descriptor for the newly opened file or -1 for invalid file. */
 void
-open (struct intr_frame *f)
+open (struct intr_frame *f, const uint32_t *args)
 {
-  lock_acquire (&thread_filesys_lock);
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_OPEN);
+  char *name = (char *) args[0];
 
-  char **name = (char **) (syscall_num + 1);
-  if (!is_valid_ptr ((void *) name, f) ||
-      !is_valid_ptr ((void *) *name, f))
+  lock_acquire (&thread_filesys_lock);
+  if (!is_valid_ptr ((void *) name, f))
     {
       lock_release (&thread_filesys_lock);
       thread_exit ();
     }
 
-  struct file *file = filesys_open (*name);
+  struct file *file = filesys_open (name);
 
   if (file == NULL)
     {
@@ -233,7 +302,7 @@ open (struct intr_frame *f)
       return;
     }
 
-  struct thread *curr = thread_current ();
+  struct thread *curr = process_current ();
   int i;
   for (i = 0; i < MAX_FILES; i++)
     if (curr->open_files[i].used == 0)
@@ -256,24 +325,16 @@ open (struct intr_frame *f)
     thread's open_files list. If an invalid file descriptor is given, the thread is killed.
     Returns the size of the file. */
 void
-filesize (struct intr_frame *f)
+filesize (struct intr_frame *f, const uint32_t *args)
 {
-  lock_acquire (&thread_filesys_lock);
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_FILESIZE);
-
-  int *fd = syscall_num + 1;
-  if (!is_valid_ptr ((void *) fd, f))
-    {
-      lock_release (&thread_filesys_lock);
-      thread_exit ();
-    }
+  int fd = (int) args[0];
 
-  struct thread *curr = thread_current ();
+  lock_acquire (&thread_filesys_lock);
+  struct thread *curr = process_current ();
   int i;
   for (i = 0; i < MAX_FILES; i++)
     {
-      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == *fd)
+      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == fd)
         {
           ASSERT (curr->open_files[i].file != NULL);
           f->eax = file_length (curr->open_files[i].file);
@@ -291,44 +352,38 @@ filesize (struct intr_frame *f)
     Checks if the file descriptor is standard input and if it isn't, checks the current thread's open_files. 
     Returns the amount of characters read. */
 void
-read (struct intr_frame *f)
+read (struct intr_frame *f, const uint32_t *args)
 {
+  int fd = (int) args[0];
+  char *buffer = (char *) args[1];
+  unsigned size = args[2];
+
   lock_acquire (&thread_filesys_lock);
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_READ);
-
-  int *fd = syscall_num + 1;
-  char **buffer = (char **) (syscall_num + 2);
-  unsigned *size = (unsigned *) (syscall_num + 3);
-
-  if (!is_valid_ptr ((void *) fd, f) ||
-      !is_valid_ptr ((void *) buffer, f) ||
-      !is_valid_ptr ((void *) *buffer, f) ||
-      !is_valid_ptr ((void *) size, f) ||
-      !is_writable_buffer (buffer, *size))
+  if (!is_valid_ptr ((void *) buffer, f) ||
+      !is_writable_buffer (&buffer, size))
     {
       lock_release (&thread_filesys_lock);
       thread_exit ();
     }
 
-  if (*fd == STDIN_FILENO)
+  if (fd == STDIN_FILENO)
     {
       char c;
       c = input_getc ();
-      memcpy(*buffer, &c, 1);  
+      memcpy(buffer, &c, 1);  
       f->eax = 1;
       lock_release (&thread_filesys_lock);
       return;
     }
 
-  struct thread *curr = thread_current ();
+  struct thread *curr = process_current ();
   int i;
   for (i = 0; i < MAX_FILES; i++)
     {
-      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == *fd)
+      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == fd)
         {
           ASSERT (curr->open_files[i].file != NULL);
-          f->eax = file_read (curr->open_files[i].file, *buffer, *size);
+          f->eax = file_read (curr->open_files[i].file, buffer, size);
           lock_release (&thread_filesys_lock);
           return;
         }
@@ -343,41 +398,35 @@ read (struct intr_frame *f)
     Checks if the file descriptor is standard output and if it isn't, checks the current thread's open_files. 
     Returns the amount of characters written. */
 void
-write (struct intr_frame *f)
+write (struct intr_frame *f, const uint32_t *args)
 {
-  lock_acquire (&thread_filesys_lock);
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_WRITE);
-
-  int *fd = syscall_num + 1;
-  char **buffer = (char **) (syscall_num + 2);
-  unsigned *size = (unsigned *) (syscall_num + 3);
+  int fd = (int) args[0];
+  char *buffer = (char *) args[1];
+  unsigned size = args[2];
 
-  if (!is_valid_ptr ((void *) fd, f) ||
-      !is_valid_ptr ((void *) buffer, f) ||
-      !is_valid_ptr ((void *) *buffer, f) ||
-      !is_valid_ptr ((void *) size, f))
+  lock_acquire (&thread_filesys_lock);
+  if (!is_valid_ptr ((void *) buffer, f))
     {
       lock_release (&thread_filesys_lock);
       thread_exit ();
     }
 
-  if (*fd == STDOUT_FILENO)
+  if (fd == STDOUT_FILENO)
     {
-      putbuf (*buffer, *size);
-      f->eax = *size;
+      putbuf (buffer, size);
+      f->eax = size;
       lock_release (&thread_filesys_lock);
       return;
     }
 
-  struct thread *curr = thread_current ();
+  struct thread *curr = process_current ();
   int i;
   for (i = 0; i < MAX_FILES; i++)
     {
-      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == *fd)
+      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == fd)
         {
           ASSERT (curr->open_files[i].file != NULL);
-          f->eax = file_write (curr->open_files[i].file, *buffer, *size);
+          f->eax = file_write (curr->open_files[i].file, buffer, size);
           lock_release (&thread_filesys_lock);
           return;
         }
@@ -391,30 +440,20 @@ write (struct intr_frame *f)
 /* Changes the next byte to be read or written in open file fd to position,
   expressed in bytes from the beginning of the file. (Thus, a position of 0 is the file's start.) . */
 void
-seek (struct intr_frame *f)
+seek (struct intr_frame *f UNUSED, const uint32_t *args)
 {
-  lock_acquire (&thread_filesys_lock);
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_SEEK);
-
-  int *fd = syscall_num + 1;
-  unsigned *position = (unsigned *) (syscall_num + 2);
+  int fd = (int) args[0];
+  unsigned position = args[1];
 
-  if (!is_valid_ptr ((void *) fd, f) ||
-      !is_valid_ptr ((void *) position, f))
-    {
-      lock_release (&thread_filesys_lock);
-      thread_exit ();
-    }
-
-  struct thread *curr = thread_current ();
+  lock_acquire (&thread_filesys_lock);
+  struct thread *curr = process_current ();
   int i;
   for (i = 0; i < MAX_FILES; i++)
     {
-      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == *fd)
+      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == fd)
         {
           ASSERT (curr->open_files[i].file != NULL);
-          file_seek (curr->open_files[i].file, *position);
+          file_seek (curr->open_files[i].file, position);
           lock_release (&thread_filesys_lock);
           return;
         }
@@ -428,24 +467,16 @@ seek (struct intr_frame *f)
 /* Returns the position of the next byte to be read or
    written in open file fd, expressed in bytes from the beginning of the file. */
 void
-tell (struct intr_frame *f)
+tell (struct intr_frame *f, const uint32_t *args)
 {
-  lock_acquire (&thread_filesys_lock);
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_TELL);
-
-  int *fd = syscall_num + 1;
-  if (!is_valid_ptr ((void *) fd, f))
-    {
-      lock_release (&thread_filesys_lock);
-      thread_exit ();
-    }
+  int fd = (int) args[0];
 
-  struct thread *curr = thread_current ();
+  lock_acquire (&thread_filesys_lock);
+  struct thread *curr = process_current ();
   int i;
   for (i = 0; i < MAX_FILES; i++)
     {
-      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == *fd)
+      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == fd)
         {
           ASSERT (curr->open_files[i].file != NULL);
           f->eax = file_tell (curr->open_files[i].file);
@@ -462,24 +493,16 @@ tell (struct intr_frame *f)
 /* Closes file descriptor fd. Exiting or terminating a process implicitly
    closes all its open file descriptors, as if by calling this function for each one. */
 void
-close (struct intr_frame *f)
+close (struct intr_frame *f UNUSED, const uint32_t *args)
 {
-  lock_acquire (&thread_filesys_lock);
-  int *syscall_num = (int *) (f->esp);
-  ASSERT (*syscall_num == SYS_CLOSE);
-
-  int *fd = syscall_num + 1;
-  if (!is_valid_ptr ((void *) fd, f))
-    {
-      lock_release (&thread_filesys_lock);
-      thread_exit ();
-    }
+  int fd = (int) args[0];
 
-  struct thread *curr = thread_current ();
+  lock_acquire (&thread_filesys_lock);
+  struct thread *curr = process_current ();
   int i;
   for (i = 0; i < MAX_FILES; i++)
     {
-      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == *fd)
+      if (curr->open_files[i].used == 1 && curr->open_files[i].fd == fd)
         {
           ASSERT (curr->open_files[i].file != NULL);
           file_close (curr->open_files[i].file);
@@ -493,3 +516,202 @@ close (struct intr_frame *f)
   lock_release (&thread_filesys_lock);
   thread_exit ();
 }
+
+/* Applies advice to the pages in a range of the process's address space.
+    Returns 0 on success, -1 if the range or the advice is invalid. */
+void
+madvise (struct intr_frame *f, const uint32_t *args)
+{
+  void *addr = (void *) args[0];
+  size_t length = args[1];
+  int advice = (int) args[2];
+
+  f->eax = page_advise (thread_current ()->spt, addr, length, advice) ? 0 : -1;
+}
+
+/* Faults in and pins a range of the process's address space so it is never evicted.
+    Returns 0 on success, -1 if the range is not mapped or would exceed the process's limit. */
+void
+mlock (struct intr_frame *f, const uint32_t *args)
+{
+  void *addr = (void *) args[0];
+  size_t length = args[1];
+
+  f->eax = page_mlock (thread_current ()->spt, addr, length) ? 0 : -1;
+}
+
+/* Unpins a range of the process's address space pinned by mlock.
+    Returns 0 on success, -1 if the range is invalid. */
+void
+munlock (struct intr_frame *f, const uint32_t *args)
+{
+  void *addr = (void *) args[0];
+  size_t length = args[1];
+
+  f->eax = page_munlock (thread_current ()->spt, addr, length) ? 0 : -1;
+}
+
+/* Grows or shrinks the process's heap by the given number of bytes.
+    Returns the old end of the heap, or -1 if the heap cannot be moved there. */
+void
+sbrk (struct intr_frame *f, const uint32_t *args)
+{
+  intptr_t increment = (intptr_t) args[0];
+
+  f->eax = (uint32_t) process_sbrk (increment);
+}
+
+/* Stores the nanoseconds since boot, from the TSC-based kernel clock,
+    into the given user int64_t, which does not fit in eax. */
+void
+clock_ns (struct intr_frame *f, const uint32_t *args)
+{
+  int64_t *ns = (int64_t *) args[0];
+  if (!is_valid_ptr ((void *) ns, f) ||
+      !is_valid_ptr ((uint8_t *) (ns + 1) - 1, f))
+    thread_exit ();
+
+  struct spt *spt = thread_current ()->spt;
+  lock_acquire (&spt->fault_lock);
+  struct page *first = page_find (spt, pg_round_down (ns));
+  struct page *last = page_find (spt, pg_round_down ((uint8_t *) (ns + 1) - 1));
+  bool writable = first != NULL && first->writable
+                  && last != NULL && last->writable;
+  lock_release (&spt->fault_lock);
+  if (!writable)
+    thread_exit ();
+
+  *ns = timer_ns ();
+}
+
+/* Starts a new thread in the calling process.  It enters user mode at
+    the given entry point with func and aux on its stack, as though
+    called as entry (func, aux).  Returns the new thread's tid, or
+    TID_ERROR if no stack slot or thread could be had. */
+void
+uthread_create (struct intr_frame *f, const uint32_t *args)
+{
+  void *entry = (void *) args[0];
+  void *func = (void *) args[1];
+  void *aux = (void *) args[2];
+  if (!is_valid_ptr (entry, f))
+    thread_exit ();
+
+  f->eax = process_thread_create ((void (*) (void)) entry, func, aux);
+}
+
+/* Waits for a thread started by the caller to exit and returns its
+    exit status, just as wait does for a child process. */
+void
+uthread_join (struct intr_frame *f, const uint32_t *args)
+{
+  tid_t tid = (tid_t) args[0];
+
+  f->eax = process_wait (tid);
+}
+
+/* Sleeps on or wakes the futex at an aligned user int.  FUTEX_WAIT sleeps while
+    the int holds val, for at most timeout_ms milliseconds if that is positive,
+    and returns 0 if woken, -1 if the int did not hold val, -2 on timeout, or
+    -3 if the int is not mapped.
+    FUTEX_WAKE wakes up to val sleepers and returns how many it woke. */
+void
+futex (struct intr_frame *f, const uint32_t *args)
+{
+  int *uaddr = (int *) args[0];
+  int op = (int) args[1];
+  int val = (int) args[2];
+  int timeout_ms = (int) args[3];
+  if (!is_valid_ptr ((void *) uaddr, f) ||
+      (uintptr_t) uaddr % sizeof (int) != 0)
+    thread_exit ();
+
+  switch (op)
+    {
+      case FUTEX_WAIT:
+        f->eax = futex_wait (uaddr, val,
+                             timeout_ms > 0
+                             ? DIV_ROUND_UP ((int64_t) timeout_ms * TIMER_FREQ,
+                                             1000)
+                             : 0);
+        break;
+      case FUTEX_WAKE:
+        f->eax = futex_wake (uaddr, val);
+        break;
+      default:
+        f->eax = -1;
+        break;
+    }
+}
+
+/* Copies the calling thread's scheduling counters and the scheduler's
+    latency histogram into the given user struct sched_stats.
+    Returns 0 on success, -1 if the struct is not writable. */
+void
+sched_stats (struct intr_frame *f, const uint32_t *args)
+{
+  struct sched_stats *ustats = (struct sched_stats *) args[0];
+  struct sched_stats stats;
+
+  thread_sched_stats (&stats);
+  f->eax = copy_to_user (ustats, &stats, sizeof stats) ? 0 : -1;
+}
+
+/* Copies the resource usage of the calling process, for RUSAGE_SELF,
+    or of its children it has waited for, for RUSAGE_CHILDREN, into
+    the given user struct rusage.  Returns 0 on success, -1 for any
+    other WHO or if the struct is not writable. */
+void
+getrusage (struct intr_frame *f, const uint32_t *args)
+{
+  int who = args[0];
+  struct rusage *uusage = (struct rusage *) args[1];
+  struct thread *curr = process_current ();
+  struct rusage usage;
+  enum intr_level old_level;
+
+  if (who != RUSAGE_SELF && who != RUSAGE_CHILDREN)
+    {
+      f->eax = -1;
+      return;
+    }
+
+  old_level = intr_disable ();
+  usage = who == RUSAGE_SELF ? curr->rusage : curr->child_rusage;
+  intr_set_level (old_level);
+  f->eax = copy_to_user (uusage, &usage, sizeof usage) ? 0 : -1;
+}
+
+/* Puts the calling thread in the real-time class, to run for the
+    given budget in every period, both in milliseconds, or takes it
+    out of the class if the period is 0.  The period is rounded
+    down and the budget up to whole timer ticks.  Returns 0 on
+    success, -1 if the budget does not fit in the period or the
+    thread cannot be admitted. */
+void
+sched_setrt (struct intr_frame *f, const uint32_t *args)
+{
+  int period_ms = args[0];
+  int budget_ms = args[1];
+  int64_t period, budget;
+
+  if (period_ms < 0 || budget_ms < 0)
+    {
+      f->eax = -1;
+      return;
+    }
+  period = (int64_t) period_ms * TIMER_FREQ / 1000;
+  budget = DIV_ROUND_UP ((int64_t) budget_ms * TIMER_FREQ, 1000);
+  if (period_ms != 0 && period == 0)
+    f->eax = -1;
+  else
+    f->eax = thread_set_rt (period, budget) ? 0 : -1;
+}
+
+/* Gives up the rest of the calling real-time thread's budget,
+    returning once its next period has begun. */
+void
+sched_rt_yield (struct intr_frame *f UNUSED, const uint32_t *args UNUSED)
+{
+  thread_rt_yield ();
+}
@@ -1,15 +1,20 @@
 #include "kernel/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include "kernel/flags.h"
 #include "kernel/interrupt.h"
 #include "kernel/intr-stubs.h"
+#include "kernel/malloc.h"
 #include "kernel/palloc.h"
+#include "kernel/spinlock.h"
 #include "kernel/switch.h"
 #include "kernel/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "kernel/process.h"
 #endif
@@ -19,9 +24,26 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO queue
+   per priority, and bit P of ready_bitmap is set when
+   ready_queues[P] is not empty, so finding the highest-priority
+   ready thread is a bit scan, however many threads are ready.
+
+   Real-time threads (see thread_set_rt()) with budget left in
+   their current period wait on rt_queue instead, earliest
+   deadline first, and run ahead of every priority queue.  Those
+   that have spent their budget wait on rt_throttled, also by
+   deadline, until their next period begins. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint32_t ready_bitmap[(PRI_MAX + 32) / 32];
+static struct list rt_queue;            /* Real-time threads with budget. */
+static struct list rt_throttled;        /* Real-time threads out of budget. */
+static int ready_cnt;                   /* Number of ready threads. */
+
+/* Released once the blocking thread is switched out; see
+   thread_block_unlock(). */
+static struct spinlock *switch_unlock;
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -33,6 +55,19 @@ static struct thread *idle_thread;
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
+/* Cache of pages freed by exited threads, so that creating a
+   thread usually skips the page allocator.  Pages on dirty_pages
+   still hold their old struct thread; the idle thread zeroes that
+   area and moves them to clean_pages, which thread_create() then
+   uses as is.  Only the struct thread area is ever zeroed: the
+   kernel stack above it needs no initialization.  Protected by
+   disabling interrupts. */
+#define PAGE_CACHE_MAX 32
+static struct thread *dirty_pages[PAGE_CACHE_MAX];
+static struct thread *clean_pages[PAGE_CACHE_MAX];
+static int dirty_cnt, clean_cnt;
+static int cached_cnt;          /* Pages in the cache or being zeroed. */
+
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
@@ -49,8 +84,15 @@ struct kernel_thread_frame
 
 /* Statistics. */
 static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
+static long long kernel_ticks;  /* # of timer ticks in the kernel. */
+static long long user_ticks;    /* # of timer ticks in user mode. */
+static long long voluntary_cnt; /* # of switches a thread asked for. */
+static long long involuntary_cnt; /* # of switches forced by preemption. */
+
+/* Histogram of wakeup-to-run latency: the time from a thread
+   becoming ready in thread_unblock() or thread_yield() until
+   schedule() picks it.  See lib/sched.h for the buckets. */
+static uint64_t latency_hist[SCHED_LATENCY_BUCKETS];
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
@@ -61,6 +103,23 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler. */
+#define MLFQS_PRIORITY_TICKS 4  /* # of timer ticks between updates. */
+static fixed_t load_avg;        /* Estimated ready threads, last minute. */
+
+/* Threads whose recent_cpu or nice is not zero.  The once-a-second
+   decay of recent_cpu only changes these threads, since it leaves
+   a zero recent_cpu at zero when nice is zero, so it walks this
+   list rather than every thread. */
+static struct list active_list;
+
+/* Real-time scheduling class.  Utilizations are in thousandths
+   of the CPU.  EDF meets every deadline up to a utilization of
+   1000; admission stops short of that to leave normal threads
+   some of the CPU. */
+#define RT_UTIL_MAX 900         /* Most utilization to admit. */
+static int rt_util;             /* Utilization of admitted threads. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -70,8 +129,30 @@ static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
+static void do_yield (bool preempted);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct thread *thread_page_get (void);
+static void thread_page_scrub (void);
+static struct child_status *child_status_create (void);
+static void thread_exit_notify (struct thread *);
+static unsigned child_status_hash (const struct hash_elem *, void *);
+static bool child_status_less (const struct hash_elem *,
+                               const struct hash_elem *, void *);
+static void child_status_destroy (struct hash_elem *, void *);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static struct thread *ready_highest (void);
+static void mlfqs_activate (struct thread *);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_update_second (void);
+static void latency_record (struct thread *);
+static bool runs_before (const struct thread *, const struct thread *);
+static void rt_replenish (struct thread *, int64_t now);
+static void rt_release (struct thread *cur, int64_t now);
+static int64_t rt_next_release (void);
+static bool rt_deadline_less (const struct list_elem *,
+                              const struct list_elem *, void *aux);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -89,15 +170,22 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  lock_init (&thread_filesys_lock);
-  list_init (&ready_list);
+  lock_init (&tid_lock, "tid");
+  lock_init (&thread_filesys_lock, "filesys");
+  for (i = 0; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
+  list_init (&rt_queue);
+  list_init (&rt_throttled);
+  list_init (&active_list);
   list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
+  memset (initial_thread, 0, sizeof *initial_thread);
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
@@ -121,24 +209,69 @@ thread_start (void)
 }
 
 /* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
+   Thus, this function runs in an external interrupt context.
+   USER is true if the tick interrupted user mode. */
 void
-thread_tick (void) 
+thread_tick (bool user) 
 {
   struct thread *t = thread_current ();
+  int64_t now = timer_ticks ();
 
   /* Update statistics. */
   if (t == idle_thread)
     idle_ticks++;
-#ifdef USERPROG
-  else if (t->pagedir != NULL)
-    user_ticks++;
-#endif
+  else if (user)
+    {
+      user_ticks++;
+      thread_rusage (t)->user_ticks++;
+    }
   else
-    kernel_ticks++;
+    {
+      kernel_ticks++;
+      thread_rusage (t)->kernel_ticks++;
+    }
+
+  /* Charge a real-time thread's budget, throttling it once this
+     period's budget is spent, and let throttled threads whose next
+     period has begun run again. */
+  if (t->rt_period != 0)
+    {
+      rt_replenish (t, now);
+      if (t->rt_left > 0)
+        t->rt_left--;
+      if (t->rt_left == 0 && intr_context ())
+        intr_yield_on_return ();
+    }
+  rt_release (t, now);
+
+  if (thread_mlfqs)
+    {
+      struct thread *next;
+
+      if (t != idle_thread)
+        {
+          t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+          mlfqs_activate (t);
+        }
+      if (now % TIMER_FREQ == 0)
+        mlfqs_update_second ();
 
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+      /* Only the running thread's recent_cpu changed since the
+         last update, so it is the only priority to recompute. */
+      if (now % MLFQS_PRIORITY_TICKS == 0 && t != idle_thread
+          && intr_context ())
+        {
+          mlfqs_update_priority (t);
+          next = ready_highest ();
+          if (next != NULL && runs_before (next, t))
+            intr_yield_on_return ();
+        }
+    }
+
+  /* Enforce preemption.  Ticks counted up after a tickless idle
+     period arrive outside interrupt context, in the idle thread,
+     which blocks again right away anyway. */
+  if (++thread_ticks >= TIME_SLICE && intr_context ())
     intr_yield_on_return ();
 }
 
@@ -146,8 +279,70 @@ thread_tick (void)
 void
 thread_print_stats (void) 
 {
+  int last, i;
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread: %lld voluntary, %lld involuntary switches, "
+          "%"PRIu64" preemptions\n",
+          voluntary_cnt, involuntary_cnt, intr_preemptions ());
+
+  for (last = SCHED_LATENCY_BUCKETS - 1; last > 0; last--)
+    if (latency_hist[last] != 0)
+      break;
+  printf ("Thread: wakeup latency");
+  for (i = 0; i <= last; i++)
+    if (i == SCHED_LATENCY_BUCKETS - 1)
+      printf (", >=%d us: %"PRIu64, 1 << (i - 1), latency_hist[i]);
+    else
+      printf ("%s<%d us: %"PRIu64, i == 0 ? " " : ", ", 1 << i,
+              latency_hist[i]);
+  printf ("\n");
+}
+
+/* Fills in STATS with the running thread's switch counts and time
+   spent ready, and the scheduler's totals. */
+void
+thread_sched_stats (struct sched_stats *stats)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  stats->voluntary_switches = cur->voluntary_switches;
+  stats->involuntary_switches = cur->involuntary_switches;
+  stats->ready_ns = cur->ready_ns;
+  stats->preemptions = intr_preemptions ();
+  memcpy (stats->latency, latency_hist, sizeof stats->latency);
+  intr_set_level (old_level);
+}
+
+/* Returns the usage record that T's activity is charged to: that
+   of T's process if T belongs to a user process, else T's own. */
+struct rusage *
+thread_rusage (struct thread *t)
+{
+#ifdef USERPROG
+  if (t->leader != NULL)
+    return &t->leader->rusage;
+#endif
+  return &t->rusage;
+}
+
+/* Adds each of SRC's counts to DST's. */
+void
+rusage_add (struct rusage *dst, const struct rusage *src)
+{
+  dst->user_ticks += src->user_ticks;
+  dst->kernel_ticks += src->kernel_ticks;
+  dst->minor_faults += src->minor_faults;
+  dst->major_faults += src->major_faults;
+  dst->swap_ins += src->swap_ins;
+  dst->swap_outs += src->swap_outs;
+  dst->blocks_read += src->blocks_read;
+  dst->blocks_written += src->blocks_written;
+  dst->voluntary_switches += src->voluntary_switches;
+  dst->involuntary_switches += src->involuntary_switches;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -162,14 +357,14 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, it runs right away. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
 {
   struct thread *t;
+  struct child_status *cs;
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
@@ -179,13 +374,21 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = thread_page_get ();
   if (t == NULL)
     return TID_ERROR;
+  cs = child_status_create ();
+  if (cs == NULL)
+    {
+      thread_page_free (t);
+      return TID_ERROR;
+    }
 
   /* Initialize thread. */
   init_thread (t, name, priority);
-  tid = t->tid = allocate_tid ();
+  tid = t->tid = cs->tid = allocate_tid ();
+  t->child_status = cs;
+  hash_insert (&thread_current ()->children, &cs->elem);
 
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack' 
@@ -211,6 +414,7 @@ thread_create (const char *name, int priority,
 
   /* Add to run queue. */
   thread_unblock (t);
+  thread_preempt (t);
 
   return tid;
 }
@@ -232,6 +436,22 @@ thread_block (void)
   schedule ();
 }
 
+/* Like thread_block(), but also releases LOCK, which the caller
+   holds, once the running thread is off the CPU.  A thread that
+   queues itself on a wait list guarded by LOCK and then calls
+   this cannot be woken, on any CPU, before it has stopped
+   running. */
+void
+thread_block_unlock (struct spinlock *lock)
+{
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  thread_current ()->status = THREAD_BLOCKED;
+  switch_unlock = lock;
+  schedule ();
+}
+
 /* Transitions a blocked thread T to the ready-to-run state.
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
@@ -249,8 +469,9 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  ready_push (t);
   t->status = THREAD_READY;
+  t->ready_since = timer_ns ();
   intr_set_level (old_level);
 }
 
@@ -295,26 +516,65 @@ thread_exit (void)
   ASSERT (!intr_context ());
 
   struct thread *curr = thread_current ();
+  int i;
 
+  thread_set_rt (0, 0);
 #ifdef USERPROG
   process_exit ();
 #endif
 
+  /* Close our files here rather than in thread_schedule_tail(),
+     where interrupts are off and closing, which may sleep, is not
+     allowed. */
+  if (curr->exec_file != NULL)
+    file_close (curr->exec_file);
+  for (i = 0; i < MAX_FILES; i++)
+    if (curr->open_files[i].used == 1)
+      {
+        ASSERT (curr->open_files[i].file != NULL);
+        file_close (curr->open_files[i].file);
+      }
+
+#ifdef USERPROG
+  /* Only the main thread speaks for the process. */
+  if (curr->leader == NULL || curr->leader == curr)
+#endif
+    printf ("%s: exit(%d)\n", curr->name, curr->exit_status);
+  thread_exit_notify (curr);
+
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
-  printf ("%s: exit(%d)\n", curr->name, curr->exit_status);
   list_remove (&curr->allelem);
+  if (curr->active)
+    list_remove (&curr->active_elem);
   curr->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
 }
 
 /* Yields the CPU.  The current thread is not put to sleep and
-   may be scheduled again immediately at the scheduler's whim. */
+   may be scheduled again immediately at the scheduler's whim.
+   Counts as a voluntary switch. */
 void
 thread_yield (void) 
+{
+  do_yield (false);
+}
+
+/* Yields the CPU because a thread that should run ahead of the
+   current one became ready, or the current one used up its time
+   slice or budget.  Counts as an involuntary switch. */
+void
+thread_yield_preempted (void)
+{
+  do_yield (true);
+}
+
+/* Yields the CPU, recording whether PREEMPTED forced it. */
+static void
+do_yield (bool preempted)
 {
   struct thread *cur = thread_current ();
   enum intr_level old_level;
@@ -323,8 +583,16 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
+    ready_push (cur);
+  else
+    {
+      /* An interrupt woke a thread that preempts the idle thread
+         in the middle of a tickless countdown. */
+      timer_idle_exit ();
+    }
   cur->status = THREAD_READY;
+  cur->ready_since = timer_ns ();
+  cur->preempted = preempted;
   schedule ();
   intr_set_level (old_level);
 }
@@ -346,11 +614,171 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's priority to NEW_PRIORITY.  Donations
+   it has received still apply.  Yields if a ready thread now has
+   a higher priority. */
 void
 thread_set_priority (int new_priority) 
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  struct thread *next;
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  /* The MLFQS scheduler sets priorities itself. */
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  thread_refresh_priority (cur);
+  intr_set_level (old_level);
+
+  old_level = intr_disable ();
+  next = ready_highest ();
+  intr_set_level (old_level);
+  if (next != NULL)
+    thread_preempt (next);
+}
+
+/* Returns the share of the CPU, in thousandths, that a real-time
+   thread with PERIOD and BUDGET reserves, rounded up. */
+static int
+rt_utilization (int period, int budget)
+{
+  return period != 0 ? DIV_ROUND_UP ((int64_t) budget * 1000, period) : 0;
+}
+
+/* Puts the running thread in the real-time class, to run for up
+   to BUDGET timer ticks in every PERIOD ticks ahead of all normal
+   threads, earliest deadline first, with the first period
+   starting now.  A PERIOD of 0 returns it to the normal class.
+   Returns false, leaving the thread as it was, if BUDGET is not
+   between 1 and PERIOD or if admitting it would take the
+   utilization of the real-time class past RT_UTIL_MAX. */
+bool
+thread_set_rt (int period, int budget)
+{
+  struct thread *cur = thread_current ();
+  bool was_rt = cur->rt_period != 0;
+  enum intr_level old_level;
+  int util;
+
+  if (period != 0 && (budget < 1 || budget > period))
+    return false;
+
+  old_level = intr_disable ();
+  util = (rt_util - rt_utilization (cur->rt_period, cur->rt_budget)
+          + rt_utilization (period, budget));
+  if (util > RT_UTIL_MAX)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  rt_util = util;
+  cur->rt_period = period;
+  cur->rt_budget = cur->rt_left = budget;
+  cur->rt_deadline = timer_ticks () + period;
+  intr_set_level (old_level);
+
+  /* Leaving the class may let a normal thread outrank us. */
+  if (was_rt && period == 0)
+    thread_yield ();
+  return true;
+}
+
+/* Gives up the rest of the running real-time thread's budget for
+   this period, so that it next runs when its next period begins.
+   Does nothing for a normal thread. */
+void
+thread_rt_yield (void)
+{
+  struct thread *cur = thread_current ();
+
+  if (cur->rt_period != 0)
+    {
+      cur->rt_left = 0;
+      thread_yield ();
+    }
+}
+
+/* Raises T's effective priority to PRIORITY, if that is higher,
+   moving it to the matching run queue if it is ready.  Interrupts
+   must be off. */
+void
+thread_donate_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->priority >= priority)
+    return;
+  if (t->status == THREAD_READY)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = priority;
+}
+
+/* Recomputes T's effective priority as the higher of its base
+   priority and the priorities donated through the locks it
+   holds.  Used when T drops a lock or changes its base priority,
+   so it may lower the priority.  Interrupts must be off. */
+void
+thread_refresh_priority (struct thread *t)
+{
+  struct list_elem *e;
+  int priority = t->base_priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+       e = list_next (e))
+    {
+      struct lock *l = list_entry (e, struct lock, elem);
+      if (l->priority > priority)
+        priority = l->priority;
+    }
+
+  if (t->status == THREAD_READY && t->priority != priority)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = priority;
+}
+
+/* Yields the CPU if T should run ahead of the running thread.
+   In an interrupt handler, the yield happens on return from the
+   interrupt. */
+void
+thread_preempt (struct thread *t)
+{
+  if (!runs_before (t, thread_current ()))
+    return;
+  if (intr_context ())
+    intr_yield_on_return ();
+  else
+    thread_yield_preempted ();
+}
+
+/* Orders threads in the order they should run: real-time threads
+   by deadline, then the rest by priority, highest first.  As a
+   list_less_func on `elem', finds the thread to wake first with
+   list_min(). */
+bool
+thread_priority_more (const struct list_elem *a_, const struct list_elem *b_,
+                      void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return runs_before (a, b);
 }
 
 /* Returns the current thread's priority. */
@@ -360,35 +788,126 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE.  Under the MLFQS
+   scheduler, also recomputes its priority, yielding if it no
+   longer has the highest; otherwise NICE is only stored, and the
+   priority set by thread_set_priority() and donation stands. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  struct thread *next;
+  enum intr_level old_level;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  if (!thread_mlfqs)
+    {
+      cur->nice = nice;
+      return;
+    }
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  mlfqs_activate (cur);
+  mlfqs_update_priority (cur);
+  next = ready_highest ();
+  intr_set_level (old_level);
+
+  if (next != NULL)
+    thread_preempt (next);
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent = fp_round (thread_current ()->recent_cpu * 100);
+  intr_set_level (old_level);
+  return recent;
+}
+
+/* Puts T on the active list if it is not there already. */
+static void
+mlfqs_activate (struct thread *t)
+{
+  if (!t->active)
+    {
+      t->active = true;
+      list_push_back (&active_list, &t->active_elem);
+    }
+}
+
+/* Recomputes T's priority from its recent_cpu and nice, moving it
+   to the matching run queue if it is ready. */
+static void
+mlfqs_update_priority (struct thread *t)
+{
+  int priority = PRI_MAX - fp_trunc (t->recent_cpu / 4) - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+
+  if (t->status == THREAD_READY && t->priority != priority)
+    {
+      ready_remove (t);
+      t->priority = t->base_priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = t->base_priority = priority;
+}
+
+/* Once a second, updates the load average, decays recent_cpu, and
+   recomputes priorities.  Threads whose recent_cpu decays to zero
+   with zero nice leave the active list; their priority is then
+   PRI_MAX and stays there until they run again. */
+static void
+mlfqs_update_second (void)
+{
+  struct thread *cur = thread_current ();
+  int ready = ready_cnt + (cur != idle_thread ? 1 : 0);
+  fixed_t coeff;
+  struct list_elem *e;
+
+  load_avg = fp_mul (fp_div (fp_from_int (59), fp_from_int (60)), load_avg)
+             + fp_from_int (ready) / 60;
+  coeff = fp_div (2 * load_avg, fp_add_int (2 * load_avg, 1));
+
+  for (e = list_begin (&active_list); e != list_end (&active_list); )
+    {
+      struct thread *t = list_entry (e, struct thread, active_elem);
+
+      t->recent_cpu = fp_add_int (fp_mul (coeff, t->recent_cpu), t->nice);
+      mlfqs_update_priority (t);
+      if (t->recent_cpu == 0 && t->nice == 0)
+        {
+          t->active = false;
+          e = list_remove (e);
+        }
+      else
+        e = list_next (e);
+    }
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -409,10 +928,18 @@ idle (void *idle_started_ UNUSED)
 
   for (;;) 
     {
+      /* Prepare freed thread pages for reuse while there is time. */
+      thread_page_scrub ();
+
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
 
+      /* Nothing is runnable, so stop the periodic tick until the
+         next sleeper is due or throttled real-time thread is
+         released. */
+      timer_idle_enter (rt_next_release ());
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -424,8 +951,21 @@ idle (void *idle_started_ UNUSED)
          time.
 
          See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
-      asm volatile ("sti; hlt" : : : "memory");
+         7.11.1 "HLT Instruction".
+
+         While a tickless countdown runs and no thread is ready,
+         halt again: the interrupts that chain the countdown's
+         one-shots, and those that made nothing runnable, leave
+         nothing to do. */
+      for (;;)
+        {
+          asm volatile ("sti; hlt" : : : "memory");
+          intr_disable ();
+          if (!timer_idle_sleeping () || ready_highest () != NULL)
+            break;
+        }
+      timer_idle_exit ();
+      intr_enable ();
     }
 }
 
@@ -462,7 +1002,7 @@ is_thread (struct thread *t)
 }
 
 /* Does basic initialization of T as a blocked thread named
-   NAME. */
+   NAME.  T's struct thread must already be zeroed. */
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
@@ -470,23 +1010,28 @@ init_thread (struct thread *t, const char *name, int priority)
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
 
-  memset (t, 0, sizeof *t);
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  list_init (&t->held_locks);
+  if (t != initial_thread && thread_mlfqs)
+    {
+      /* Inherit the creating thread's niceness and CPU usage, and
+         take the priority they give rather than PRIORITY. */
+      struct thread *cur = running_thread ();
+      t->nice = cur->nice;
+      t->recent_cpu = cur->recent_cpu;
+      if (t->nice != 0 || t->recent_cpu != 0)
+        mlfqs_activate (t);
+      mlfqs_update_priority (t);
+    }
   t->magic = THREAD_MAGIC;
 
   t->parent = list_empty (&all_list) ? NULL : thread_current ();
   t->exit_status = -1;
   t->exec_file = NULL;
-  list_init (&t->live_children);
-  list_init (&t->zombie_children);
-  sema_init (&t->exit_sema, 0);
   sema_init (&t->exec_sema, 0);
-  barrier ();
-  if (t->parent != NULL)
-    list_push_back (&t->parent->live_children, &t->child_elem);
   list_push_back (&all_list, &t->allelem);
 }
 
@@ -511,10 +1056,68 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  struct thread *t = ready_highest ();
+
+  if (t == NULL)
     return idle_thread;
+  ready_remove (t);
+  return t;
+}
+
+/* Adds T to the back of the run queue for its priority, or, if T
+   is a real-time thread, to the real-time queue or, if T has no
+   budget left, the throttled list.  Interrupts must be off. */
+static void
+ready_push (struct thread *t)
+{
+  if (t->rt_period != 0)
+    {
+      rt_replenish (t, timer_ticks ());
+      list_insert_ordered (t->rt_left > 0 ? &rt_queue : &rt_throttled,
+                           &t->elem, rt_deadline_less, NULL);
+    }
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    {
+      list_push_back (&ready_queues[t->priority], &t->elem);
+      ready_bitmap[t->priority / 32] |= 1u << (t->priority % 32);
+    }
+  ready_cnt++;
+}
+
+/* Removes ready thread T from its run queue.  Interrupts must be
+   off. */
+static void
+ready_remove (struct thread *t)
+{
+  list_remove (&t->elem);
+  if (t->rt_period == 0 && list_empty (&ready_queues[t->priority]))
+    ready_bitmap[t->priority / 32] &= ~(1u << (t->priority % 32));
+  ready_cnt--;
+}
+
+/* Returns the first real-time thread with budget left, if any, and
+   otherwise the thread at the front of the highest-priority
+   non-empty run queue, or a null pointer if no thread is ready.
+   Interrupts must be off. */
+static struct thread *
+ready_highest (void)
+{
+  int word;
+
+  if (!list_empty (&rt_queue))
+    return list_entry (list_front (&rt_queue), struct thread, elem);
+  for (word = sizeof ready_bitmap / sizeof *ready_bitmap - 1; word >= 0;
+       word--)
+    if (ready_bitmap[word] != 0)
+      {
+        uint32_t bit;
+
+        /* Index of the most significant set bit. */
+        asm ("bsrl %1, %0" : "=r" (bit) : "rm" (ready_bitmap[word]));
+        return list_entry (list_front (&ready_queues[word * 32 + bit]),
+                           struct thread, elem);
+      }
+  return NULL;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -537,15 +1140,20 @@ void
 thread_schedule_tail (struct thread *prev)
 {
   struct thread *cur = running_thread ();
-  struct thread *zombie;
-  struct list_elem *e; 
-  int i;
 
   ASSERT (intr_get_level () == INTR_OFF);
 
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
 
+  /* Now that the previous thread is off the CPU, others may wake
+     it. */
+  if (switch_unlock != NULL)
+    {
+      spin_unlock (switch_unlock);
+      switch_unlock = NULL;
+    }
+
   /* Start new time slice. */
   thread_ticks = 0;
 
@@ -562,47 +1170,194 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
+      thread_page_free (prev);
+    }
+}
 
-      if (prev->exec_file != NULL)
-        file_close (prev->exec_file);
+/* Allocates an exit record for a new child of the running
+   thread, or returns a null pointer if memory is exhausted.  The
+   caller sets its tid and adds it to the running thread's
+   children. */
+static struct child_status *
+child_status_create (void)
+{
+  struct thread *cur = thread_current ();
+  struct child_status *cs;
 
-      for (i = 0; i < MAX_FILES; i++)
-        {
-          if (prev->open_files[i].used == 1)
-            {
-              ASSERT (prev->open_files[i].file != NULL);
-              file_close (prev->open_files[i].file);
-            }
-        }
+  /* Initialized on first use, since the initial thread is set up
+     before malloc() works. */
+  if (!cur->has_children)
+    {
+      if (!hash_init (&cur->children, child_status_hash,
+                      child_status_less, NULL))
+        return NULL;
+      cur->has_children = true;
+    }
 
-        
-      struct list_elem *trav;
+  cs = malloc (sizeof *cs);
+  if (cs == NULL)
+    return NULL;
+  cs->exit_status = -1;
+  memset (&cs->rusage, 0, sizeof cs->rusage);
+  cs->refcnt = 2;
+  sema_init (&cs->exit_sema, 0);
+  return cs;
+}
 
-      for (trav = list_begin (&prev->live_children); trav != list_end (&prev->live_children);
-           trav = list_next (trav))
-        {
-          struct thread *f = list_entry (trav, struct thread, child_elem);
-          f->parent = NULL;
-        }
+/* Returns the exit record of the running thread's child with the
+   given TID, or a null pointer if there is no such child or it
+   has already been waited for. */
+struct child_status *
+thread_find_child (tid_t tid)
+{
+  struct thread *cur = thread_current ();
+  struct child_status key;
+  struct hash_elem *e;
+
+  if (!cur->has_children)
+    return NULL;
+  key.tid = tid;
+  e = hash_find (&cur->children, &key.elem);
+  return e != NULL ? hash_entry (e, struct child_status, elem) : NULL;
+}
 
+/* Drops one reference to CS, freeing it when both the parent and
+   the child are done with it. */
+void
+child_status_release (struct child_status *cs)
+{
+  enum intr_level old_level;
+  bool dead;
 
-      e = list_begin (&prev->zombie_children);
-      while (e != list_end (&prev->zombie_children))
-        {
-          zombie = list_entry (e, struct thread, child_elem);
-          e = list_remove (e);
-          palloc_free_page (zombie);
-        }
+  old_level = intr_disable ();
+  dead = --cs->refcnt == 0;
+  intr_set_level (old_level);
 
-      if (prev->parent != NULL)
+  if (dead)
+    free (cs);
+}
+
+/* Publishes exiting thread T's status, and its usage if T is the
+   last thread of its process, to its parent and drops T's
+   references to its own and its children's exit records. */
+static void
+thread_exit_notify (struct thread *t)
+{
+  if (t->child_status != NULL)
+    {
+      t->child_status->exit_status = t->exit_status;
+      if (thread_rusage (t) == &t->rusage)
         {
-          list_remove (&prev->child_elem);
-          list_push_back (&prev->parent->zombie_children, &prev->child_elem);
-          sema_up (&prev->exit_sema);
+          t->child_status->rusage = t->rusage;
+          rusage_add (&t->child_status->rusage, &t->child_rusage);
         }
-      else
-        palloc_free_page (prev);
+      sema_up (&t->child_status->exit_sema);
+      child_status_release (t->child_status);
+      t->child_status = NULL;
+    }
+  if (t->has_children)
+    {
+      hash_destroy (&t->children, child_status_destroy);
+      t->has_children = false;
+    }
+}
+
+/* Hashes a child exit record by tid. */
+static unsigned
+child_status_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct child_status *cs = hash_entry (e, struct child_status, elem);
+  return hash_int (cs->tid);
+}
+
+/* Orders child exit records by tid. */
+static bool
+child_status_less (const struct hash_elem *a, const struct hash_elem *b,
+                   void *aux UNUSED)
+{
+  return (hash_entry (a, struct child_status, elem)->tid
+          < hash_entry (b, struct child_status, elem)->tid);
+}
+
+/* Drops the parent's reference to the exit record containing E. */
+static void
+child_status_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  child_status_release (hash_entry (e, struct child_status, elem));
+}
+
+/* Returns a page for a new thread with its struct thread area
+   zeroed, from the cache if possible, or a null pointer if no
+   page is available. */
+static struct thread *
+thread_page_get (void)
+{
+  struct thread *t = NULL;
+  bool clean = false;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (clean_cnt > 0)
+    {
+      t = clean_pages[--clean_cnt];
+      clean = true;
     }
+  else if (dirty_cnt > 0)
+    t = dirty_pages[--dirty_cnt];
+  if (t != NULL)
+    cached_cnt--;
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    t = palloc_get_page (0);
+  if (t != NULL && !clean)
+    memset (t, 0, sizeof *t);
+  return t;
+}
+
+/* Frees the page of thread T, which has exited, keeping it in the
+   cache if there is room. */
+void
+thread_page_free (struct thread *t)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (cached_cnt < PAGE_CACHE_MAX)
+    {
+      dirty_pages[dirty_cnt++] = t;
+      cached_cnt++;
+      t = NULL;
+    }
+  intr_set_level (old_level);
+
+  if (t != NULL)
+    palloc_free_page (t);
+}
+
+/* Zeroes the struct thread area of each cached dirty page and
+   marks it clean.  Called by the idle thread with interrupts on,
+   so that a thread that becomes ready meanwhile can preempt it. */
+static void
+thread_page_scrub (void)
+{
+  for (;;)
+    {
+      struct thread *t;
+
+      intr_disable ();
+      if (dirty_cnt == 0)
+        break;
+      t = dirty_pages[--dirty_cnt];
+      intr_enable ();
+
+      memset (t, 0, sizeof *t);
+
+      intr_disable ();
+      clean_pages[clean_cnt++] = t;
+      intr_enable ();
+    }
+  intr_enable ();
 }
 
 /* Schedules a new process.  At entry, interrupts must be off and
@@ -623,11 +1378,132 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  if (next != idle_thread)
+    latency_record (next);
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      if (cur->status == THREAD_READY && cur->preempted)
+        {
+          cur->involuntary_switches++;
+          thread_rusage (cur)->involuntary_switches++;
+          involuntary_cnt++;
+        }
+      else
+        {
+          cur->voluntary_switches++;
+          thread_rusage (cur)->voluntary_switches++;
+          voluntary_cnt++;
+        }
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
+/* Records how long T, which schedule() is about to run, waited
+   since it became ready. */
+static void
+latency_record (struct thread *t)
+{
+  uint64_t ns = timer_ns () - t->ready_since;
+  uint64_t us = ns / 1000;
+  int bucket = 0;
+
+  t->ready_ns += ns;
+  while (us != 0 && bucket < SCHED_LATENCY_BUCKETS - 1)
+    {
+      us >>= 1;
+      bucket++;
+    }
+  latency_hist[bucket]++;
+}
+
+/* Returns true if A should run ahead of B: a real-time thread with
+   budget left ahead of any other thread, the earlier deadline
+   between two of them, and otherwise the higher priority. */
+static bool
+runs_before (const struct thread *a, const struct thread *b)
+{
+  bool a_rt = a->rt_period != 0 && a->rt_left > 0;
+  bool b_rt = b->rt_period != 0 && b->rt_left > 0;
+
+  if (a_rt || b_rt)
+    return a_rt && (!b_rt || a->rt_deadline < b->rt_deadline);
+  return a->priority > b->priority;
+}
+
+/* Starts real-time thread T's next period, with a full budget, if
+   its current period is over at tick NOW.  A thread that slept
+   through whole periods starts the one that NOW falls in. */
+static void
+rt_replenish (struct thread *t, int64_t now)
+{
+  if (now >= t->rt_deadline)
+    {
+      t->rt_deadline += ((now - t->rt_deadline) / t->rt_period + 1)
+                        * t->rt_period;
+      t->rt_left = t->rt_budget;
+    }
+}
+
+/* Moves the throttled real-time threads whose next period has
+   begun by tick NOW to the real-time queue, asking for a yield
+   on return from the interrupt if one of them should run ahead of
+   CUR, the running thread.  Also starts the next period of queued
+   threads whose period ended before they got to run, so that they
+   do not keep its deadline and leftover budget.  Interrupts must
+   be off. */
+static void
+rt_release (struct thread *cur, int64_t now)
+{
+  while (!list_empty (&rt_queue))
+    {
+      struct thread *t = list_entry (list_front (&rt_queue),
+                                     struct thread, elem);
+      if (t->rt_deadline > now)
+        break;
+      list_pop_front (&rt_queue);
+      rt_replenish (t, now);
+      list_insert_ordered (&rt_queue, &t->elem, rt_deadline_less, NULL);
+    }
+  while (!list_empty (&rt_throttled))
+    {
+      struct thread *t = list_entry (list_front (&rt_throttled),
+                                     struct thread, elem);
+      if (t->rt_deadline > now)
+        break;
+      list_pop_front (&rt_throttled);
+      rt_replenish (t, now);
+      list_insert_ordered (&rt_queue, &t->elem, rt_deadline_less, NULL);
+      if (runs_before (t, cur) && intr_context ())
+        intr_yield_on_return ();
+    }
+}
+
+/* Returns the tick at which the first throttled real-time
+   thread is due to be released, or INT64_MAX if none is throttled.
+   Interrupts must be off. */
+static int64_t
+rt_next_release (void)
+{
+  int64_t release = INT64_MAX;
+
+  if (!list_empty (&rt_throttled))
+    release = list_entry (list_front (&rt_throttled), struct thread,
+                          elem)->rt_deadline;
+  return release;
+}
+
+/* Orders real-time threads by deadline, earliest first. */
+static bool
+rt_deadline_less (const struct list_elem *a_, const struct list_elem *b_,
+                  void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->rt_deadline < b->rt_deadline;
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
@@ -2,10 +2,14 @@
 #define KERNEL_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <rusage.h>
+#include <sched.h>
 #include "kernel/synch.h"
+#include "kernel/fixed-point.h"
 #include "filesys/file.h"
 
 /* States in a thread's life cycle. */
@@ -45,6 +49,10 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the MLFQS scheduler. */
+#define NICE_MIN -20                    /* Nicest. */
+#define NICE_MAX 20                     /* Least nice. */
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -110,17 +118,40 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Effective priority. */
+    int base_priority;                  /* Priority before donation. */
+    struct lock *waiting_lock;          /* Lock this thread is blocked on. */
+    struct list held_locks;             /* Locks held, for donation. */
+    int nice;                           /* MLFQS niceness. */
+    fixed_t recent_cpu;                 /* MLFQS recent CPU time. */
+    bool active;                        /* On the MLFQS active list. */
+    struct list_elem active_elem;       /* List element for active list. */
+    int64_t ready_since;                /* timer_ns() when it last became ready. */
+    uint64_t ready_ns;                  /* Total time ready but not running. */
+    bool preempted;                     /* Yielding because it was preempted? */
+    unsigned voluntary_switches;        /* Switched out on its own account. */
+    unsigned involuntary_switches;      /* Switched out by preemption. */
+    struct rusage rusage;               /* Usage charged to us; see thread_rusage(). */
+    struct rusage child_rusage;         /* Usage of children waited for. */
+    int rt_period;                      /* Real-time period in ticks, or 0. */
+    int rt_budget;                      /* Real-time run ticks per period. */
+    int rt_left;                        /* Budget ticks left this period. */
+    int64_t rt_deadline;                /* Tick at which this period ends. */
     struct list_elem allelem;           /* List element for all threads list. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 
-    struct thread *parent;              /* Pointer to this thread's parent. */
-    struct list live_children;          /* List of this thread's live children. */
-    struct list zombie_children;        /* List of this thread's zombie children. */
-    struct list_elem child_elem;        /* List element for parent's children lists. */
-    struct semaphore exit_sema;         /* Semaphore for parent/child exit synchronization. */
+    /* Owned by devices/timer.c. */
+    int64_t wakeup_tick;                /* Tick to wake up at, if sleeping. */
+    struct list_elem sleep_elem;        /* List element for the timing wheel. */
+    bool sleeping;                      /* SLEEP_ELEM is on the timing wheel? */
+
+    struct thread *parent;              /* Pointer to this thread's parent, valid
+                                           until the exec handshake is done. */
+    struct hash children;               /* Children's exit records, by tid. */
+    bool has_children;                  /* Whether CHILDREN is initialized. */
+    struct child_status *child_status;  /* Our record in the parent's CHILDREN. */
     int exit_status;                    /* This thread's exit status. */
 
     struct file_mapping open_files[MAX_FILES];  /* An array of open files along
@@ -135,12 +166,40 @@ struct thread
     /* Owned by kernel/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
     struct spt *spt;                     /* Supplemental page table. */
+    struct thread *leader;              /* Main thread of our process. */
+    int locked_pages;                   /* Leader: mlocked pages, under spt->fault_lock. */
+    uint8_t *heap_start;                /* Leader: start of the sbrk heap. */
+    uint8_t *heap_end;                  /* Leader: current program break. */
+    int thread_cnt;                     /* Leader: other threads, process_get()s. */
+    bool exiting;                       /* Leader: exiting, so others must too. */
+    uint32_t stack_slots;               /* Leader: thread stack slots in use. */
+    struct semaphore threads_done;      /* Leader: upped as other threads exit. */
+    struct lock heap_lock;              /* Leader: serializes sbrk. */
+    uint8_t *stack_top;                 /* Top of our user stack's extent. */
+    size_t stack_size;                  /* Size of our user stack's extent. */
+    uint8_t *stack_bottom;              /* Lowest page mapped for the stack. */
+    int stack_window;                   /* Pages to map on the next stack growth. */
+    void *user_esp;                     /* User esp at the last system call. */
 #endif
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
 
+/* Exit record of a child thread, shared by the child and its
+   parent so that neither has to outlive the other.  Freed when
+   both have dropped their reference. */
+struct child_status
+  {
+    tid_t tid;                          /* Child's thread identifier. */
+    int exit_status;                    /* Set when the child exits. */
+    struct rusage rusage;               /* Set when the child exits: its own
+                                           usage plus its children's. */
+    int refcnt;                         /* 2 while both parent and child live. */
+    struct semaphore exit_sema;         /* Upped when the child exits. */
+    struct hash_elem elem;              /* Element in parent's CHILDREN. */
+  };
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -149,13 +208,21 @@ extern bool thread_mlfqs;
 void thread_init (void);
 void thread_start (void);
 
-void thread_tick (void);
+void thread_tick (bool user);
 void thread_print_stats (void);
+void thread_sched_stats (struct sched_stats *);
+struct rusage *thread_rusage (struct thread *);
+void rusage_add (struct rusage *, const struct rusage *);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
+void thread_page_free (struct thread *);
+struct child_status *thread_find_child (tid_t);
+void child_status_release (struct child_status *);
+
 void thread_block (void);
+void thread_block_unlock (struct spinlock *);
 void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
@@ -164,6 +231,7 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_yield_preempted (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -171,6 +239,13 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+bool thread_set_rt (int period, int budget);
+void thread_rt_yield (void);
+void thread_donate_priority (struct thread *, int);
+void thread_refresh_priority (struct thread *);
+void thread_preempt (struct thread *);
+bool thread_priority_more (const struct list_elem *,
+                           const struct list_elem *, void *aux);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
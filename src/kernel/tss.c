@@ -1,5 +1,6 @@
 #include "kernel/tss.h"
 #include <debug.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include "kernel/gdt.h"
 #include "kernel/thread.h"
@@ -75,6 +76,19 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* Model-specific registers for SYSENTER.  See [IA32-v3a] 5.8.7
+   "Performing Fast Calls to System Procedures with the SYSENTER
+   and SYSEXIT Instructions". */
+#define MSR_SYSENTER_CS  0x174  /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* Fast system call entry point, in intr-stubs.S. */
+void sysenter_entry (void);
+
+static bool sysenter_present (void);
+static void sysenter_init (void);
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -86,6 +100,7 @@ tss_init (void)
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update ();
+  sysenter_init ();
 }
 
 /* Returns the kernel TSS. */
@@ -104,3 +119,41 @@ tss_update (void)
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
 }
+
+/* Returns true if the CPU supports SYSENTER and SYSEXIT,
+   according to CPUID function 1, EDX bit 11.  The earliest
+   Pentium Pro models set that bit without supporting them. */
+static bool
+sysenter_present (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  uint32_t family, model, stepping;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return (edx & (1u << 11)) != 0
+         && !(family == 6 && model < 3 && stepping < 3);
+}
+
+/* Points the SYSENTER MSRs at sysenter_entry(), if the CPU has
+   them.  SYSENTER loads the stack segment from the selector after
+   SEL_KCSEG, and SYSEXIT the user code and stack segments from
+   the two after that, which is the order of our GDT.
+
+   SYSENTER does not read the TSS, so rather than rewriting an MSR
+   on every thread switch, its stack pointer points at the TSS's
+   esp0 member and sysenter_entry() loads the real kernel stack
+   from there. */
+static void
+sysenter_init (void)
+{
+  if (!sysenter_present ())
+    return;
+
+  asm volatile ("wrmsr" : : "c" (MSR_SYSENTER_CS), "a" (SEL_KCSEG), "d" (0));
+  asm volatile ("wrmsr" : : "c" (MSR_SYSENTER_ESP), "a" (&tss->esp0), "d" (0));
+  asm volatile ("wrmsr" : : "c" (MSR_SYSENTER_EIP), "a" (sysenter_entry),
+                "d" (0));
+}
@@ -0,0 +1,91 @@
+#include "kernel/vdso.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "kernel/interrupt.h"
+#include "kernel/pagedir.h"
+#include "kernel/synch.h"
+#include "kernel/thread.h"
+#include "kernel/vaddr.h"
+
+/* The shared page.  It lives in the kernel image rather than the
+   user pool, so it is never evicted and needs no setup before the
+   timer starts writing to it. */
+static uint8_t vdso_page[PGSIZE] __attribute__ ((aligned (PGSIZE)));
+static volatile struct vdso_data *const vdso
+  = (volatile struct vdso_data *) vdso_page;
+
+static void begin_update (void);
+static void end_update (void);
+
+/* Maps the shared page read-only into page directory PD at
+   VDSO_ADDR.  Returns true if successful, false if memory for a
+   page table is short. */
+bool
+vdso_map (uint32_t *pd)
+{
+  vdso->timer_freq = TIMER_FREQ;
+  return pagedir_set_page (pd, (void *) VDSO_ADDR, vdso_page, false);
+}
+
+/* Removes the shared page from PD, which must be done before PD
+   is destroyed, since pagedir_destroy() frees every page it
+   maps. */
+void
+vdso_unmap (uint32_t *pd)
+{
+  pagedir_clear_page (pd, (void *) VDSO_ADDR);
+}
+
+/* Publishes the timer tick count.  Called on every tick. */
+void
+vdso_set_ticks (int64_t ticks)
+{
+  enum intr_level old_level = intr_disable ();
+
+  begin_update ();
+  vdso->ticks = ticks;
+  end_update ();
+  intr_set_level (old_level);
+}
+
+/* Publishes the TSC calibration, as used by timer_ns(). */
+void
+vdso_set_tsc (uint64_t tsc_hz, uint64_t tsc_base, int64_t ticks_base)
+{
+  enum intr_level old_level = intr_disable ();
+
+  begin_update ();
+  vdso->tsc_hz = tsc_hz;
+  vdso->tsc_base = tsc_base;
+  vdso->ticks_base = ticks_base;
+  end_update ();
+  intr_set_level (old_level);
+}
+
+/* Publishes T, which is about to run, as the running thread. */
+void
+vdso_set_thread (const struct thread *t)
+{
+#ifdef USERPROG
+  vdso->pid = t->leader != NULL ? t->leader->tid : t->tid;
+#else
+  vdso->pid = t->tid;
+#endif
+  vdso->tid = t->tid;
+}
+
+/* Marks the clock fields as being updated. */
+static void
+begin_update (void)
+{
+  vdso->seq++;
+  barrier ();
+}
+
+/* Marks the update of the clock fields as done. */
+static void
+end_update (void)
+{
+  barrier ();
+  vdso->seq++;
+}
@@ -0,0 +1,16 @@
+#ifndef KERNEL_VDSO_H
+#define KERNEL_VDSO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vdso.h>
+
+struct thread;
+
+bool vdso_map (uint32_t *pd);
+void vdso_unmap (uint32_t *pd);
+void vdso_set_ticks (int64_t ticks);
+void vdso_set_tsc (uint64_t tsc_hz, uint64_t tsc_base, int64_t ticks_base);
+void vdso_set_thread (const struct thread *);
+
+#endif /* kernel/vdso.h */
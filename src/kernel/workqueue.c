@@ -0,0 +1,129 @@
+#include "kernel/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "kernel/interrupt.h"
+#include "kernel/synch.h"
+#include "kernel/thread.h"
+
+/* Number of worker threads.  More than one, so that work that
+   sleeps on I/O does not hold up the rest. */
+#define WORKER_CNT 2
+
+/* Work queued and not yet started, oldest first.  Interrupt
+   handlers may queue work, so this is protected by disabling
+   interrupts. */
+static struct list work_list;
+
+/* Counts the work in work_list that workers have been told
+   about.  Work queued by an interrupt handler is only counted by
+   the softirq that runs as the interrupt returns, so the handler
+   itself never wakes a thread. */
+static struct semaphore work_sema;
+static unsigned deferred_cnt;   /* Queued from interrupts, not counted. */
+static int work_softirq;        /* Softirq that counts deferred work. */
+
+static thread_func worker;
+static void work_wake (void);
+
+/* Starts the worker threads.  Must be called after
+   thread_start(). */
+void
+workqueue_init (void)
+{
+  char name[16];
+  int i;
+
+  list_init (&work_list);
+  sema_init (&work_sema, 0);
+  work_softirq = softirq_register (work_wake, "work");
+
+  for (i = 0; i < WORKER_CNT; i++)
+    {
+      snprintf (name, sizeof name, "worker%d", i);
+      if (thread_create (name, PRI_DEFAULT, worker, NULL) == TID_ERROR)
+        PANIC ("could not start %s", name);
+    }
+}
+
+/* Initializes WORK to call FUNC with AUX when it runs. */
+void
+work_init (struct work *work, work_func *func, void *aux)
+{
+  ASSERT (work != NULL);
+  ASSERT (func != NULL);
+
+  work->func = func;
+  work->aux = aux;
+  work->pending = false;
+}
+
+/* Queues WORK to be run by a worker thread, unless it is already
+   queued and has not started yet, in which case it will run only
+   once.  Returns true if WORK was queued.  May be called from an
+   interrupt handler. */
+bool
+work_queue (struct work *work)
+{
+  enum intr_level old_level;
+  bool queued = false;
+  bool wake = false;
+
+  ASSERT (work != NULL);
+
+  old_level = intr_disable ();
+  if (!work->pending)
+    {
+      work->pending = true;
+      list_push_back (&work_list, &work->elem);
+      queued = true;
+      if (intr_context ())
+        {
+          deferred_cnt++;
+          softirq_raise (work_softirq);
+        }
+      else
+        wake = true;
+    }
+  intr_set_level (old_level);
+
+  if (wake)
+    sema_up (&work_sema);
+  return queued;
+}
+
+/* Softirq that tells the workers about work queued by interrupt
+   handlers. */
+static void
+work_wake (void)
+{
+  enum intr_level old_level;
+  unsigned cnt;
+
+  old_level = intr_disable ();
+  cnt = deferred_cnt;
+  deferred_cnt = 0;
+  intr_set_level (old_level);
+
+  while (cnt-- > 0)
+    sema_up (&work_sema);
+}
+
+/* Worker thread: runs queued work, oldest first, forever. */
+static void
+worker (void *aux UNUSED)
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *work;
+
+      sema_down (&work_sema);
+
+      old_level = intr_disable ();
+      work = list_entry (list_pop_front (&work_list), struct work, elem);
+      work->pending = false;
+      intr_set_level (old_level);
+
+      work->func (work->aux);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef KERNEL_WORKQUEUE_H
+#define KERNEL_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+
+/* Deferred work, run later by one of a pool of kernel worker
+   threads.  Work functions run in thread context, so unlike
+   interrupt handlers and softirqs they may sleep. */
+typedef void work_func (void *aux);
+
+struct work
+  {
+    struct list_elem elem;      /* Element in the pending work list. */
+    work_func *func;            /* Function to call. */
+    void *aux;                  /* Argument for FUNC. */
+    bool pending;               /* Queued but not yet started? */
+  };
+
+void workqueue_init (void);
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct work *);
+
+#endif /* kernel/workqueue.h */
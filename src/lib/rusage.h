@@ -0,0 +1,27 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/* Resource usage of a process, as returned by the getrusage
+   system call.  All threads of a process add to its counts. */
+
+/* Whose usage getrusage() reports. */
+#define RUSAGE_SELF 0           /* The calling process. */
+#define RUSAGE_CHILDREN 1       /* Its children that have been waited for. */
+
+struct rusage
+  {
+    uint32_t user_ticks;                /* Timer ticks in user mode. */
+    uint32_t kernel_ticks;              /* Timer ticks in the kernel. */
+    uint32_t minor_faults;              /* Page faults resolved without I/O. */
+    uint32_t major_faults;              /* Page faults that read from disk. */
+    uint32_t swap_ins;                  /* Pages read back from swap. */
+    uint32_t swap_outs;                 /* Pages written out to swap. */
+    uint32_t blocks_read;               /* Block device sectors read. */
+    uint32_t blocks_written;            /* Block device sectors written. */
+    uint32_t voluntary_switches;        /* Switched out blocking or exiting. */
+    uint32_t involuntary_switches;      /* Switched out by preemption. */
+  };
+
+#endif /* lib/rusage.h */
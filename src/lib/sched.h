@@ -0,0 +1,26 @@
+#ifndef __LIB_SCHED_H
+#define __LIB_SCHED_H
+
+#include <stdint.h>
+
+/* Scheduler measurements, as returned by the sched_stats system
+   call. */
+
+/* Buckets of the wakeup-to-run latency histogram.  Bucket 0
+   counts waits under 1 us, bucket B > 0 waits from 2**(B-1) us up
+   to 2**B us, and the last bucket everything longer. */
+#define SCHED_LATENCY_BUCKETS 20
+
+struct sched_stats
+  {
+    /* The calling thread. */
+    uint64_t voluntary_switches;        /* Switched out blocking or exiting. */
+    uint64_t involuntary_switches;      /* Switched out by preemption. */
+    uint64_t ready_ns;                  /* Total time ready but not running. */
+
+    /* All threads since boot. */
+    uint64_t preemptions;               /* Yields on interrupt return. */
+    uint64_t latency[SCHED_LATENCY_BUCKETS]; /* Wakeup-to-run latencies. */
+  };
+
+#endif /* lib/sched.h */
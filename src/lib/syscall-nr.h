@@ -28,7 +28,37 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_MADVISE,                /* Give the VM a hint about a range. */
+    SYS_MLOCK,                  /* Fault in and pin a range. */
+    SYS_MUNLOCK,                /* Unpin a range. */
+    SYS_SBRK,                   /* Move the end of the heap. */
+    SYS_CLOCK_NS,               /* Read the nanosecond clock. */
+    SYS_THREAD_CREATE,          /* Start a thread in this process. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+    SYS_FUTEX,                  /* Sleep on or wake a user-space int. */
+    SYS_SCHED_STATS,            /* Read scheduler measurements. */
+    SYS_GETRUSAGE,              /* Read resource usage. */
+    SYS_SCHED_SETRT,            /* Join or leave the real-time class. */
+    SYS_SCHED_RT_YIELD          /* Wait for the next real-time period. */
+  };
+
+/* Advice values for SYS_MADVISE. */
+enum
+  {
+    MADV_NORMAL,                /* No special treatment. */
+    MADV_SEQUENTIAL,            /* Read ahead and drop behind. */
+    MADV_WILLNEED,              /* Fault the range in now. */
+    MADV_DONTNEED               /* Release the range's frames and swap. */
+  };
+
+/* Operations for SYS_FUTEX. */
+enum
+  {
+    FUTEX_WAIT,                 /* Sleep while the int holds a value. */
+    FUTEX_WAKE                  /* Wake threads sleeping on the int. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,412 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <synch.h>
+#include <syscall.h>
+
+/* A user-space malloc() built on the sbrk() system call.
+
+   It follows the kernel's malloc() in kernel/malloc.c: requests
+   are rounded up to a power of 2 and served from the descriptor
+   for that size, whose blocks are carved out of page-sized
+   "arenas" obtained from the heap.
+
+   In front of each descriptor's free list sits a small cache of
+   recently freed blocks, in the manner of a thread cache.  The
+   cache is a plain LIFO stack, so the common malloc()/free()
+   pair costs a couple of pointer moves and touches no arena
+   bookkeeping.  Only when the cache is full does free() return
+   blocks to the free list, and only then can an arena become
+   entirely unused and be given back.
+
+   Requests larger than the biggest descriptor's blocks, a quarter
+   of a page, get their own run of pages with the size in the
+   arena header.  Freed runs and arenas at
+   the top of the heap are returned with a negative sbrk().
+   Others are kept for reuse; the pages of a freed run past its
+   header are handed back to the VM with MADV_DONTNEED so they do
+   not hold frames or swap while unused.
+
+   All threads of the process share the descriptors, caches and
+   heap, so malloc() and free() hold malloc_lock throughout. */
+
+#define PGSIZE 4096             /* Bytes in a page. */
+#define CACHE_MAX 16            /* Blocks cached per descriptor. */
+
+/* Free block. */
+struct block
+  {
+    struct block *prev;         /* Previous block in free list. */
+    struct block *next;         /* Next block in cache or free list. */
+  };
+
+/* Descriptor. */
+struct desc
+  {
+    size_t block_size;          /* Size of each element in bytes. */
+    size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    struct block *cache;        /* Recently freed blocks (LIFO). */
+    size_t cache_cnt;           /* Number of blocks in cache. */
+    struct block *free_list;    /* List of free blocks. */
+  };
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x5be1c0de
+
+/* Arena. */
+struct arena 
+  {
+    unsigned magic;             /* Always set to ARENA_MAGIC. */
+    struct desc *desc;          /* Owning descriptor, null for big block. */
+    size_t free_cnt;            /* Free blocks; pages in big block. */
+    struct arena *next;         /* Next unused arena or big block. */
+  };
+
+/* Our set of descriptors. */
+static struct desc descs[8];    /* Descriptors. */
+static size_t desc_cnt;         /* Number of descriptors. */
+
+static struct arena *free_arenas;   /* Unused single pages. */
+static struct arena *free_bigs;     /* Unused big blocks. */
+
+/* Serializes the allocator among the process's threads.  A zeroed
+   lock is free, so it needs no lock_init(). */
+static struct lock malloc_lock;
+
+static void malloc_init (void);
+static void *malloc_locked (size_t size);
+static void free_locked (void *);
+static void *get_pages (size_t page_cnt);
+static void put_pages (struct arena *, size_t page_cnt);
+static struct arena *block_to_arena (struct block *);
+static struct block *arena_to_block (struct arena *, size_t idx);
+static void free_list_push (struct desc *, struct block *);
+static void free_list_remove (struct desc *, struct block *);
+
+/* Initializes the malloc() descriptors. */
+static void
+malloc_init (void) 
+{
+  size_t block_size;
+
+  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+    {
+      struct desc *d = &descs[desc_cnt++];
+      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+      d->block_size = block_size;
+      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+    }
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) 
+{
+  void *p;
+
+  lock_acquire (&malloc_lock);
+  p = malloc_locked (size);
+  lock_release (&malloc_lock);
+  return p;
+}
+
+/* Does the work of malloc() with malloc_lock held. */
+static void *
+malloc_locked (size_t size) 
+{
+  struct desc *d;
+  struct block *b;
+  struct arena *a;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+
+  if (desc_cnt == 0)
+    malloc_init ();
+
+  /* Find the smallest descriptor that satisfies a SIZE-byte
+     request. */
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      break;
+  if (d == descs + desc_cnt) 
+    {
+      /* SIZE is too big for any descriptor.
+         Allocate enough pages to hold SIZE plus an arena. */
+      size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
+      a = get_pages (page_cnt);
+      if (a == NULL)
+        return NULL;
+
+      /* Initialize the arena to indicate a big block of at least
+         PAGE_CNT pages, and return it. */
+      a->magic = ARENA_MAGIC;
+      a->desc = NULL;
+      return a + 1;
+    }
+
+  /* Fast path: reuse a recently freed block. */
+  if (d->cache != NULL)
+    {
+      b = d->cache;
+      d->cache = b->next;
+      d->cache_cnt--;
+      return b;
+    }
+
+  /* If the free list is empty, create a new arena. */
+  if (d->free_list == NULL)
+    {
+      size_t i;
+
+      a = get_pages (1);
+      if (a == NULL) 
+        return NULL; 
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        free_list_push (d, arena_to_block (a, i));
+    }
+
+  /* Get a block from free list and return it. */
+  b = d->free_list;
+  free_list_remove (d, b);
+  a = block_to_arena (b);
+  a->free_cnt--;
+  return b;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b) 
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  size = a * b;
+  if (size < a || size < b)
+    return NULL;
+
+  /* Allocate and zero memory. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/* Returns the number of bytes allocated for BLOCK. */
+static size_t
+block_size (void *block) 
+{
+  struct block *b = block;
+  struct arena *a = block_to_arena (b);
+  struct desc *d = a->desc;
+
+  return d != NULL ? d->block_size : PGSIZE * a->free_cnt - sizeof *a;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size) 
+{
+  if (new_size == 0) 
+    {
+      free (old_block);
+      return NULL;
+    }
+  else if (old_block != NULL && new_size <= block_size (old_block))
+    return old_block;
+  else 
+    {
+      void *new_block = malloc (new_size);
+      if (old_block != NULL && new_block != NULL)
+        {
+          size_t old_size = block_size (old_block);
+          size_t min_size = new_size < old_size ? new_size : old_size;
+          memcpy (new_block, old_block, min_size);
+          free (old_block);
+        }
+      return new_block;
+    }
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p) 
+{
+  lock_acquire (&malloc_lock);
+  free_locked (p);
+  lock_release (&malloc_lock);
+}
+
+/* Does the work of free() with malloc_lock held. */
+static void
+free_locked (void *p) 
+{
+  if (p != NULL)
+    {
+      struct block *b = p;
+      struct arena *a = block_to_arena (b);
+      struct desc *d = a->desc;
+      
+      if (d != NULL) 
+        {
+          /* It's a normal block.  Keep it in the cache if there
+             is room. */
+          if (d->cache_cnt < CACHE_MAX)
+            {
+              b->next = d->cache;
+              d->cache = b;
+              d->cache_cnt++;
+              return;
+            }
+
+          /* Add block to free list. */
+          free_list_push (d, b);
+
+          /* If the arena is now entirely unused, free it. */
+          if (++a->free_cnt >= d->blocks_per_arena) 
+            {
+              size_t i;
+
+              ASSERT (a->free_cnt == d->blocks_per_arena);
+              for (i = 0; i < d->blocks_per_arena; i++) 
+                free_list_remove (d, arena_to_block (a, i));
+              put_pages (a, 1);
+            }
+        }
+      else
+        {
+          /* It's a big block.  Free its pages. */
+          put_pages (a, a->free_cnt);
+        }
+    }
+}
+
+/* Returns an arena of at least PAGE_CNT pages, with its size in
+   pages stored in its free_cnt member, reusing unused pages if
+   possible and growing the heap otherwise.  Returns a null
+   pointer if the heap cannot grow. */
+static void *
+get_pages (size_t page_cnt) 
+{
+  struct arena **ap;
+  struct arena *a;
+  uintptr_t brk;
+
+  /* Reuse an unused arena or big block that is large enough. */
+  for (ap = page_cnt == 1 ? &free_arenas : &free_bigs; *ap != NULL;
+       ap = &(*ap)->next)
+    if ((*ap)->free_cnt >= page_cnt)
+      {
+        a = *ap;
+        *ap = a->next;
+        return a;
+      }
+
+  /* Keep the break page-aligned, then grow the heap. */
+  brk = (uintptr_t) sbrk (0);
+  if (brk % PGSIZE != 0 && sbrk (PGSIZE - brk % PGSIZE) == (void *) -1)
+    return NULL;
+  a = sbrk (page_cnt * PGSIZE);
+  if (a == (void *) -1)
+    return NULL;
+  a->free_cnt = page_cnt;
+  return a;
+}
+
+/* Gives back arena A of PAGE_CNT pages.  If it is at the top of
+   the heap, the heap shrinks; otherwise it is kept for reuse. */
+static void
+put_pages (struct arena *a, size_t page_cnt) 
+{
+  a->magic = 0;
+  if ((uint8_t *) a + page_cnt * PGSIZE == sbrk (0))
+    {
+      sbrk (-(intptr_t) (page_cnt * PGSIZE));
+      return;
+    }
+
+  a->free_cnt = page_cnt;
+  if (page_cnt == 1)
+    {
+      a->next = free_arenas;
+      free_arenas = a;
+    }
+  else
+    {
+      madvise ((uint8_t *) a + PGSIZE, (page_cnt - 1) * PGSIZE,
+               MADV_DONTNEED);
+      a->next = free_bigs;
+      free_bigs = a;
+    }
+}
+
+/* Returns the arena that block B is inside. */
+static struct arena *
+block_to_arena (struct block *b)
+{
+  struct arena *a = (struct arena *) ((uintptr_t) b & ~(PGSIZE - 1));
+
+  /* Check that the arena is valid. */
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+
+  /* Check that the block is properly aligned for the arena. */
+  ASSERT (a->desc == NULL
+          || ((uintptr_t) b % PGSIZE - sizeof *a) % a->desc->block_size == 0);
+  ASSERT (a->desc != NULL || (uintptr_t) b % PGSIZE == sizeof *a);
+
+  return a;
+}
+
+/* Returns the (IDX - 1)'th block within arena A. */
+static struct block *
+arena_to_block (struct arena *a, size_t idx) 
+{
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+  ASSERT (idx < a->desc->blocks_per_arena);
+  return (struct block *) ((uint8_t *) a
+                           + sizeof *a
+                           + idx * a->desc->block_size);
+}
+
+/* Pushes B onto the front of D's free list. */
+static void
+free_list_push (struct desc *d, struct block *b) 
+{
+  b->prev = NULL;
+  b->next = d->free_list;
+  if (d->free_list != NULL)
+    d->free_list->prev = b;
+  d->free_list = b;
+}
+
+/* Removes B from D's free list. */
+static void
+free_list_remove (struct desc *d, struct block *b) 
+{
+  if (b->prev != NULL)
+    b->prev->next = b->next;
+  else
+    d->free_list = b->next;
+  if (b->next != NULL)
+    b->next->prev = b->prev;
+}
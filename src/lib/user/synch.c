@@ -0,0 +1,126 @@
+#include <synch.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <syscall.h>
+
+/* Locks and condition variables on top of the futex system call.
+
+   A lock's state is 0 when free, 1 when held, and 2 when held
+   and some thread may be asleep waiting for it.  Taking a free
+   lock is one compare-and-swap.  A thread that finds the lock
+   held marks it 2 and sleeps on it in the kernel, and releasing
+   a lock only makes a system call if it was 2.
+
+   A condition variable is a sequence number.  A waiter notes the
+   number before it releases its lock and sleeps only while the
+   number is unchanged, so a signal between the two is not lost. */
+
+/* Atomically sets *P to NEW if it holds OLD.  Returns the value
+   *P held.  See [IA32-v2a] "CMPXCHG". */
+static inline int
+compare_and_swap (int *p, int old, int new)
+{
+  int prev;
+
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Atomically sets *P to NEW and returns the value it held.  See
+   [IA32-v2b] "XCHG": the exchange is locked implicitly. */
+static inline int
+exchange (int *p, int new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Atomically adds 1 to *P. */
+static inline void
+increment (int *p)
+{
+  asm volatile ("lock incl %0" : "+m" (*p) : : "memory");
+}
+
+/* Initializes LOCK as free. */
+void
+lock_init (struct lock *lock)
+{
+  lock->state = 0;
+}
+
+/* Acquires LOCK, sleeping until it is free if necessary. */
+void
+lock_acquire (struct lock *lock)
+{
+  int state = compare_and_swap (&lock->state, 0, 1);
+
+  if (state == 0)
+    return;
+
+  /* Contended.  Mark the lock as having waiters, whoever holds
+     it, and sleep until we are the one to take it from free. */
+  if (state != 2)
+    state = exchange (&lock->state, 2);
+  while (state != 0)
+    {
+      futex (&lock->state, FUTEX_WAIT, 2, 0);
+      state = exchange (&lock->state, 2);
+    }
+}
+
+/* Tries to acquire LOCK without sleeping and returns true if
+   successful. */
+bool
+lock_try_acquire (struct lock *lock)
+{
+  return compare_and_swap (&lock->state, 0, 1) == 0;
+}
+
+/* Releases LOCK, which the current thread must hold, and wakes a
+   waiter if there may be one. */
+void
+lock_release (struct lock *lock)
+{
+  if (exchange (&lock->state, 0) == 2)
+    futex (&lock->state, FUTEX_WAKE, 1, 0);
+}
+
+/* Initializes condition variable COND. */
+void
+cond_init (struct condition *cond)
+{
+  cond->seq = 0;
+}
+
+/* Atomically releases LOCK and waits for COND to be signaled,
+   then reacquires LOCK.  As with any condition variable, the
+   caller must recheck its condition on return. */
+void
+cond_wait (struct condition *cond, struct lock *lock)
+{
+  int seq = cond->seq;
+
+  lock_release (lock);
+  futex (&cond->seq, FUTEX_WAIT, seq, 0);
+  lock_acquire (lock);
+}
+
+/* Wakes one thread waiting on COND, if any. */
+void
+cond_signal (struct condition *cond)
+{
+  increment (&cond->seq);
+  futex (&cond->seq, FUTEX_WAKE, 1, 0);
+}
+
+/* Wakes all threads waiting on COND. */
+void
+cond_broadcast (struct condition *cond)
+{
+  increment (&cond->seq);
+  futex (&cond->seq, FUTEX_WAKE, INT_MAX, 0);
+}
@@ -0,0 +1,30 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* Lock, for the threads of one process.  Acquiring a free lock
+   and releasing one that no thread waits for never enter the
+   kernel. */
+struct lock
+  {
+    int state;                  /* 0 free, 1 held, 2 held with waiters. */
+  };
+
+void lock_init (struct lock *);
+void lock_acquire (struct lock *);
+bool lock_try_acquire (struct lock *);
+void lock_release (struct lock *);
+
+/* Condition variable. */
+struct condition
+  {
+    int seq;                    /* Bumped by each signal or broadcast. */
+  };
+
+void cond_init (struct condition *);
+void cond_wait (struct condition *, struct lock *);
+void cond_signal (struct condition *);
+void cond_broadcast (struct condition *);
+
+#endif /* lib/user/synch.h */
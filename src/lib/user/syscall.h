@@ -2,12 +2,21 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <debug.h>
+#include <rusage.h>
+#include <sched.h>
+#include <syscall-nr.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
@@ -45,4 +54,23 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int madvise (void *addr, size_t length, int advice);
+int mlock (const void *addr, size_t length);
+int munlock (const void *addr, size_t length);
+void *sbrk (intptr_t increment);
+int64_t clock_ns (void);
+pid_t getpid (void);
+tid_t gettid (void);
+tid_t thread_create (void (*func) (void *aux), void *aux);
+int thread_join (tid_t);
+int futex (int *addr, int op, int val, int timeout_ms);
+int sched_stats (struct sched_stats *);
+int getrusage (int who, struct rusage *);
+int sched_setrt (int period_ms, int budget_ms);
+void sched_rt_yield (void);
+
+/* Called by _start() before main(). */
+void syscall_probe (void);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,62 @@
+#include <syscall.h>
+#include <vdso.h>
+
+/* Readers for the page of kernel data mapped at VDSO_ADDR.  None
+   of them makes a system call. */
+
+static const volatile struct vdso_data *const vdso
+  = (const volatile struct vdso_data *) VDSO_ADDR;
+
+/* Returns the time stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the nanoseconds since boot, computed just as the
+   kernel's timer_ns() does: from the TSC once the kernel has
+   calibrated it, otherwise from timer ticks. */
+int64_t
+clock_ns (void)
+{
+  uint32_t seq;
+  int64_t ns;
+
+  do
+    {
+      seq = vdso->seq;
+      asm volatile ("" : : : "memory");
+      if (vdso->tsc_hz == 0)
+        ns = vdso->ticks * (1000 * 1000 * 1000 / vdso->timer_freq);
+      else
+        {
+          uint64_t hz = vdso->tsc_hz;
+          uint64_t cycles = rdtsc () - vdso->tsc_base;
+          ns = vdso->ticks_base * (1000 * 1000 * 1000 / vdso->timer_freq)
+               + cycles / hz * 1000 * 1000 * 1000
+               + cycles % hz * 1000 * 1000 * 1000 / hz;
+        }
+      asm volatile ("" : : : "memory");
+    }
+  while ((seq & 1) != 0 || seq != vdso->seq);
+  return ns;
+}
+
+/* Returns the process's id, which is the tid of its main
+   thread. */
+pid_t
+getpid (void)
+{
+  return vdso->pid;
+}
+
+/* Returns the calling thread's tid. */
+tid_t
+gettid (void)
+{
+  return vdso->tid;
+}
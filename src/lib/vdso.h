@@ -0,0 +1,28 @@
+#ifndef __LIB_VDSO_H
+#define __LIB_VDSO_H
+
+#include <stdint.h>
+
+/* A page of kernel data that the kernel maps read-only into every
+   user process at VDSO_ADDR, just below the stacks of its
+   threads, so that user code can read the clock or its own ids
+   without a system call.
+
+   The clock fields change together, so the kernel makes SEQ odd
+   while it updates them.  A reader retries if SEQ was odd or
+   changed while it read them. */
+#define VDSO_ADDR 0xbe7ff000
+
+struct vdso_data
+  {
+    uint32_t seq;               /* Update count, odd while updating. */
+    int32_t timer_freq;         /* Timer ticks per second. */
+    int64_t ticks;              /* Timer ticks since boot. */
+    uint64_t tsc_hz;            /* TSC cycles per second, 0 if none. */
+    uint64_t tsc_base;          /* TSC at the start of tick TICKS_BASE. */
+    int64_t ticks_base;         /* Tick at which TSC_BASE was read. */
+    int32_t tid;                /* Running thread. */
+    int32_t pid;                /* Its process: its main thread's tid. */
+  };
+
+#endif /* lib/vdso.h */
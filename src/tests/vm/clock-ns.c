@@ -0,0 +1,27 @@
+/* Reads the nanosecond clock around some work and checks that it
+   moves forward, by less than the run of the test. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  volatile int sink = 0;
+  int64_t start, prev, now;
+  int i;
+
+  start = prev = clock_ns ();
+  CHECK (start > 0, "clock is running");
+  for (i = 0; i < 100000; i++)
+    {
+      sink += i;
+      now = clock_ns ();
+      if (now < prev)
+        fail ("clock went back from %lld to %lld", prev, now);
+      prev = now;
+    }
+  CHECK (prev > start, "clock advanced");
+  CHECK (prev - start < 60LL * 1000 * 1000 * 1000, "by less than a minute");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(clock-ns) begin
+(clock-ns) clock is running
+(clock-ns) clock advanced
+(clock-ns) by less than a minute
+(clock-ns) end
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Exits the main thread while one other thread spins in user
+   mode and another sleeps on a futex with no timeout.  The process
+   must still exit, taking both of them with it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile int spinning;
+static int word;
+
+static void
+spin (void *aux UNUSED)
+{
+  for (;;)
+    spinning = 1;
+}
+
+static void
+sleep (void *aux UNUSED)
+{
+  for (;;)
+    futex (&word, FUTEX_WAIT, 0, 0);
+}
+
+void
+test_main (void)
+{
+  CHECK (thread_create (spin, NULL) != TID_ERROR, "start spinning thread");
+  CHECK (thread_create (sleep, NULL) != TID_ERROR, "start sleeping thread");
+  while (!spinning)
+    continue;
+  msg ("exiting with both still running");
+}
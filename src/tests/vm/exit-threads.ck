@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(exit-threads) begin
+(exit-threads) start spinning thread
+(exit-threads) start sleeping thread
+(exit-threads) exiting with both still running
+(exit-threads) end
+EOF
+pass;
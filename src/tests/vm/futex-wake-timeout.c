@@ -0,0 +1,52 @@
+/* Wakes timed futex waits at points spread over the last tick
+   or so before they would time out, then waits out each timeout,
+   so that a wakeup that left the waiter on the timer's sleep list
+   would have the timer wake it a second time. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUND_CNT 24
+#define TIMEOUT_MS 30
+
+static int word;
+static int64_t wake_at;
+
+static void
+waker (void *aux UNUSED)
+{
+  while (clock_ns () < wake_at)
+    continue;
+  futex (&word, FUTEX_WAKE, 1, 0);
+}
+
+void
+test_main (void)
+{
+  int idle = 0;
+  int round;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      /* Wake between 12 ms and 0.5 ms before the timeout. */
+      int64_t lead_ns = 12000000 - round * 500000;
+      int result;
+      tid_t tid;
+
+      wake_at = clock_ns () + TIMEOUT_MS * 1000000LL - lead_ns;
+      tid = thread_create (waker, NULL);
+      if (tid == TID_ERROR)
+        fail ("thread_create failed in round %d", round);
+      result = futex (&word, FUTEX_WAIT, 0, TIMEOUT_MS);
+      if (result != 0 && result != -2)
+        fail ("futex wait returned %d in round %d", result, round);
+      thread_join (tid);
+
+      /* Outlast the first wait's timeout. */
+      if (futex (&idle, FUTEX_WAIT, 0, 2 * TIMEOUT_MS) != -2)
+        fail ("idle wait did not time out in round %d", round);
+    }
+  msg ("%d rounds done", ROUND_CNT);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(futex-wake-timeout) begin
+(futex-wake-timeout) 24 rounds done
+(futex-wake-timeout) end
+EOF
+pass;
@@ -0,0 +1,71 @@
+/* Checks futex waits that fail or time out, including one on an
+   unmapped address, which must not leave its queue locked for the
+   futexes used next.  Then has several threads bump a shared
+   counter under a lock and hand items to the main thread through
+   a condition variable. */
+
+#include <synch.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITER_CNT 5000
+
+static struct lock lock;
+static struct condition done_cond;
+static int counter;
+static int done_cnt;
+
+static void
+worker (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      lock_acquire (&lock);
+      counter++;
+      lock_release (&lock);
+    }
+
+  lock_acquire (&lock);
+  done_cnt++;
+  cond_signal (&done_cond);
+  lock_release (&lock);
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  int word = 0;
+  int i;
+
+  CHECK (futex (&word, FUTEX_WAIT, 1, 0) == -1, "wait on changed word fails");
+  CHECK (futex (&word, FUTEX_WAIT, 0, 50) == -2, "wait times out");
+  CHECK (futex (&word, FUTEX_WAKE, 1, 0) == 0, "wake with no waiters");
+  CHECK (futex ((int *) 0x10000000, FUTEX_WAIT, 0, 0) == -3,
+         "wait on unmapped word fails");
+
+  lock_init (&lock);
+  cond_init (&done_cond);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_create (worker, NULL);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_create %d failed", i);
+    }
+
+  lock_acquire (&lock);
+  while (done_cnt < THREAD_CNT)
+    cond_wait (&done_cond, &lock);
+  lock_release (&lock);
+  msg ("all workers done");
+
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_join (tids[i]);
+  if (counter != THREAD_CNT * ITER_CNT)
+    fail ("counter is %d, expected %d", counter, THREAD_CNT * ITER_CNT);
+  msg ("counter is %d", counter);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(futex) begin
+(futex) wait on changed word fails
+(futex) wait times out
+(futex) wake with no waiters
+(futex) wait on unmapped word fails
+(futex) all workers done
+(futex) counter is 20000
+(futex) end
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Checks that madvise() hints do not change what a program
+   reads, except MADV_DONTNEED, which gives back zeroed memory
+   for pages without file contents. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 8
+
+static char buf[PAGE_CNT * 4096] __attribute__ ((aligned (4096)));
+
+static void
+check_pattern (int mult)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (char) (i % 251 * mult))
+      fail ("byte %zu is %d, expected %d",
+            i, buf[i], (char) (i % 251 * mult));
+}
+
+void
+test_main (void)
+{
+  size_t i;
+
+  CHECK (madvise (buf, sizeof buf, MADV_SEQUENTIAL) == 0,
+         "madvise sequential");
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = i % 251;
+  check_pattern (1);
+
+  CHECK (madvise (buf, sizeof buf, MADV_DONTNEED) == 0,
+         "madvise dontneed");
+  check_pattern (0);
+
+  CHECK (madvise (buf, sizeof buf, MADV_WILLNEED) == 0,
+         "madvise willneed");
+  check_pattern (0);
+
+  CHECK (madvise (buf + 1, 4096, MADV_NORMAL) == -1,
+         "madvise at misaligned address fails");
+}
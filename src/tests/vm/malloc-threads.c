@@ -0,0 +1,72 @@
+/* Has several threads allocate, fill, check and free blocks of
+   every size class at once, so that a malloc() without locking
+   would hand the same block to two threads or lose one. */
+
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define BLOCK_CNT 64
+#define ROUND_CNT 40
+
+static int failures;
+
+static void
+worker (void *aux)
+{
+  int id = (int) aux;
+  uint8_t *blocks[BLOCK_CNT];
+  int round, i;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < BLOCK_CNT; i++)
+        {
+          size_t size = 1 + (i * 37 + round) % 2000;
+          blocks[i] = malloc (size);
+          if (blocks[i] != NULL)
+            memset (blocks[i], id, size);
+        }
+      for (i = 0; i < BLOCK_CNT; i++)
+        {
+          size_t size = 1 + (i * 37 + round) % 2000;
+          size_t j;
+
+          if (blocks[i] == NULL)
+            {
+              failures++;
+              continue;
+            }
+          for (j = 0; j < size; j++)
+            if (blocks[i][j] != id)
+              {
+                failures++;
+                break;
+              }
+          free (blocks[i]);
+        }
+    }
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_create (worker, (void *) (i + 1));
+      if (tids[i] == TID_ERROR)
+        fail ("thread_create failed");
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_join (tids[i]);
+  if (failures != 0)
+    fail ("%d blocks missing or overwritten", failures);
+  msg ("every block kept its contents");
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(malloc-threads) begin
+(malloc-threads) every block kept its contents
+(malloc-threads) end
+EOF
+pass;
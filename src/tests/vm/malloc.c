@@ -0,0 +1,70 @@
+/* Exercises the user malloc(): many small blocks of every size
+   class, a few blocks larger than a page, realloc() and
+   calloc(), checking that no two live blocks overlap and that
+   freeing everything lets the heap shrink back. */
+
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 256
+
+static uint8_t *blocks[BLOCK_CNT];
+
+static size_t
+size_of (size_t i)
+{
+  return i % 4 == 3 ? 3000 + i * 16 : 1 + i * 7 % 1000;
+}
+
+void
+test_main (void)
+{
+  uint8_t *base = sbrk (0);
+  uint8_t *p;
+  size_t i, j;
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      blocks[i] = malloc (size_of (i));
+      if (blocks[i] == NULL)
+        fail ("malloc %zu failed", i);
+      memset (blocks[i], i, size_of (i));
+    }
+  msg ("allocated %d blocks", BLOCK_CNT);
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    for (j = 0; j < size_of (i); j++)
+      if (blocks[i][j] != (uint8_t) i)
+        fail ("block %zu byte %zu is %d, expected %d",
+              i, j, blocks[i][j], (uint8_t) i);
+  msg ("contents intact");
+
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    free (blocks[i]);
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    {
+      blocks[i] = realloc (blocks[i], size_of (i) + 2000);
+      if (blocks[i] == NULL)
+        fail ("realloc %zu failed", i);
+      for (j = 0; j < size_of (i); j++)
+        if (blocks[i][j] != (uint8_t) i)
+          fail ("realloc lost block %zu byte %zu", i, j);
+    }
+  msg ("realloc kept contents");
+
+  p = calloc (100, 50);
+  CHECK (p != NULL, "calloc");
+  for (i = 0; i < 100 * 50; i++)
+    if (p[i] != 0)
+      fail ("calloc byte %zu is %d", i, p[i]);
+  free (p);
+
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    free (blocks[i]);
+  CHECK (malloc (0) == NULL, "malloc (0) returns null");
+  CHECK ((uint8_t *) sbrk (0) - base < 64 * 4096, "heap shrank");
+}
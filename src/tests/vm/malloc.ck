@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(malloc) begin
+(malloc) allocated 256 blocks
+(malloc) contents intact
+(malloc) realloc kept contents
+(malloc) calloc
+(malloc) malloc (0) returns null
+(malloc) heap shrank
+(malloc) end
+EOF
+pass;
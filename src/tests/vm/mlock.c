@@ -0,0 +1,28 @@
+/* Pins a buffer with mlock(), checks that unmapped ranges and
+   ranges past the per-process limit are refused, and unpins the
+   buffer again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[4 * 4096] __attribute__ ((aligned (4096)));
+static char big[128 * 4096] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  size_t i;
+
+  CHECK (mlock (buf, sizeof buf) == 0, "mlock buffer");
+  memset (buf, 0x5a, sizeof buf);
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 0x5a)
+      fail ("byte %zu is %d, expected %d", i, buf[i], 0x5a);
+  CHECK (mlock ((void *) 0x10000000, 4096) == -1,
+         "mlock of unmapped range fails");
+  CHECK (mlock (big, sizeof big) == -1, "mlock past the limit fails");
+  CHECK (munlock (buf, sizeof buf) == 0, "munlock buffer");
+  CHECK (mlock (big, 32 * 4096) == 0, "mlock within the limit");
+}
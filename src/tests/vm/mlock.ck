@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock) begin
+(mlock) mlock buffer
+(mlock) mlock of unmapped range fails
+(mlock) mlock past the limit fails
+(mlock) munlock buffer
+(mlock) mlock within the limit
+(mlock) end
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Fills 2 MB of memory, more than fits in the user pool, then has
+   several threads of the process read it all back at once, in the
+   same order, so that they fault on the same swapped-out pages at
+   the same time. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define SIZE (2 * 1024 * 1024)
+#define PAGE_WORDS (4096 / sizeof (int))
+
+static int buf[SIZE / sizeof (int)];
+static int bad[THREAD_CNT];
+
+static void
+check (void *aux)
+{
+  int id = (int) aux;
+  size_t i;
+
+  for (i = 0; i < SIZE / sizeof (int); i++)
+    if (buf[i] != (int) (i / PAGE_WORDS) + (int) (i % PAGE_WORDS))
+      bad[id]++;
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  size_t i;
+  int t;
+
+  for (i = 0; i < SIZE / sizeof (int); i++)
+    buf[i] = (int) (i / PAGE_WORDS) + (int) (i % PAGE_WORDS);
+  msg ("filled");
+
+  for (t = 0; t < THREAD_CNT; t++)
+    {
+      tids[t] = thread_create (check, (void *) t);
+      if (tids[t] == TID_ERROR)
+        fail ("thread_create %d failed", t);
+    }
+  for (t = 0; t < THREAD_CNT; t++)
+    {
+      thread_join (tids[t]);
+      if (bad[t] != 0)
+        fail ("thread %d read %d bad words", t, bad[t]);
+    }
+  msg ("all threads read it back");
+}
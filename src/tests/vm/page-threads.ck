@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-threads) begin
+(page-threads) filled
+(page-threads) all threads read it back
+(page-threads) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Recurses 1024 levels deep with a 1 kB object in each frame,
+   growing the stack to about 1 MB one page at a time, and
+   checks that every frame kept its contents.  This must
+   succeed. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DEPTH 1024
+
+static unsigned
+recurse (int depth)
+{
+  unsigned char buf[1024];
+  unsigned sum;
+  size_t i;
+
+  memset (buf, depth & 0xff, sizeof buf);
+  sum = depth < DEPTH ? recurse (depth + 1) : 0;
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (depth & 0xff))
+      fail ("depth %d byte %zu is %d", depth, i, buf[i]);
+  return sum + buf[0];
+}
+
+void
+test_main (void)
+{
+  unsigned expected = 0;
+  int depth;
+
+  for (depth = 0; depth <= DEPTH; depth++)
+    expected += depth & 0xff;
+  CHECK (recurse (0) == expected, "recursion %d deep", DEPTH);
+}
@@ -0,0 +1,50 @@
+/* Checks that getrusage() counts the calling process's page
+   faults and user time, and that a child's usage is added to
+   RUSAGE_CHILDREN once the child has been waited for. */
+
+#include <rusage.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 16
+static char buf[PAGES * 4096];
+
+void
+test_main (void)
+{
+  struct rusage before, after, children;
+  int64_t start;
+  pid_t child;
+  size_t i;
+
+  CHECK (getrusage (RUSAGE_SELF, &before) == 0, "getrusage");
+  for (i = 0; i < sizeof buf; i += 4096)
+    buf[i] = 1;
+  start = clock_ns ();
+  while (clock_ns () - start < 100 * 1000 * 1000)
+    continue;
+  CHECK (getrusage (RUSAGE_SELF, &after) == 0, "getrusage again");
+  if (after.minor_faults - before.minor_faults < PAGES)
+    fail ("only %u minor faults for %d new pages",
+          after.minor_faults - before.minor_faults, PAGES);
+  if (after.user_ticks <= before.user_ticks)
+    fail ("spinning for 100 ms took no user ticks");
+  msg ("own usage counted");
+
+  CHECK (getrusage (RUSAGE_CHILDREN, &children) == 0, "getrusage children");
+  if (children.minor_faults != 0 || children.user_ticks != 0)
+    fail ("usage charged to children before any was waited for");
+  CHECK ((child = exec ("child-linear")) != -1, "exec \"child-linear\"");
+  CHECK (wait (child) == 0x42, "wait for child");
+  CHECK (getrusage (RUSAGE_CHILDREN, &children) == 0,
+         "getrusage children again");
+  if (children.minor_faults < 1024 * 1024 / 4096)
+    fail ("child's %u minor faults do not cover its 1 MB buffer",
+          children.minor_faults);
+  msg ("child's usage counted");
+
+  CHECK (getrusage (2, &after) == -1, "bad who refused");
+  CHECK (getrusage (RUSAGE_SELF, (struct rusage *) 0xc0000000) == -1,
+         "kernel buffer refused");
+}
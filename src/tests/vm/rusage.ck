@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rusage) begin
+(rusage) getrusage
+(rusage) getrusage again
+(rusage) own usage counted
+(rusage) getrusage children
+(rusage) exec "child-linear"
+(rusage) wait for child
+(rusage) getrusage children again
+(rusage) child's usage counted
+(rusage) bad who refused
+(rusage) kernel buffer refused
+(rusage) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Grows the heap with sbrk(), checks that the new pages read
+   as zeros and hold what is written to them, shrinks it again,
+   and checks that the break cannot run into the stack. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 8
+
+void
+test_main (void)
+{
+  uint8_t *base, *p;
+  size_t i;
+
+  base = sbrk (0);
+  CHECK (base != (void *) -1, "sbrk (0)");
+  CHECK (sbrk (PAGE_CNT * 4096) == base, "grow heap by %d pages", PAGE_CNT);
+  CHECK (sbrk (0) == base + PAGE_CNT * 4096, "break moved");
+
+  for (p = base; p < base + PAGE_CNT * 4096; p++)
+    if (*p != 0)
+      fail ("byte %zu is %d, expected 0", (size_t) (p - base), *p);
+  memset (base, 0xa5, PAGE_CNT * 4096);
+  for (i = 0; i < PAGE_CNT * 4096; i++)
+    if (base[i] != 0xa5)
+      fail ("byte %zu is %d, expected %d", i, base[i], 0xa5);
+
+  CHECK (sbrk (-PAGE_CNT * 4096) == base + PAGE_CNT * 4096, "shrink heap");
+  CHECK (sbrk (0) == base, "break restored");
+  CHECK (sbrk (0x7fff0000) == (void *) -1, "growth into the stack fails");
+  CHECK (sbrk (-0x10000000) == (void *) -1, "shrinking below heap fails");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sbrk) begin
+(sbrk) sbrk (0)
+(sbrk) grow heap by 8 pages
+(sbrk) break moved
+(sbrk) shrink heap
+(sbrk) break restored
+(sbrk) growth into the stack fails
+(sbrk) shrinking below heap fails
+(sbrk) end
+EOF
+pass;
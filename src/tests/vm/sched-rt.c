@@ -0,0 +1,58 @@
+/* Joins the real-time class, checks that admission stops at the
+   class's utilization bound, and that a thread spinning past its
+   budget is held off the CPU until its next period. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MS 1000000LL
+
+static int other_admitted;
+
+static void
+other (void *aux UNUSED)
+{
+  other_admitted = sched_setrt (100, 50) == 0;
+}
+
+void
+test_main (void)
+{
+  int64_t start, last, now, gap;
+  tid_t tid;
+
+  CHECK (sched_setrt (100, 200) == -1, "budget longer than period refused");
+  CHECK (sched_setrt (100, 50) == 0, "sched_setrt (100, 50)");
+  CHECK (sched_setrt (100, 95) == -1, "95%% of the CPU refused");
+
+  tid = thread_create (other, NULL);
+  CHECK (tid != TID_ERROR, "thread_create");
+  thread_join (tid);
+  if (other_admitted)
+    fail ("second thread admitted past the bound");
+  msg ("second thread refused");
+
+  /* Spin through several periods.  Each time the budget runs out
+     we should stop running for the rest of the period. */
+  CHECK (sched_setrt (100, 20) == 0, "sched_setrt (100, 20)");
+  start = last = clock_ns ();
+  gap = 0;
+  while ((now = clock_ns ()) - start < 500 * MS)
+    {
+      if (now - last > gap)
+        gap = now - last;
+      last = now;
+    }
+  if (gap < 40 * MS)
+    fail ("longest time off the CPU was only %lld ms", gap / MS);
+  msg ("overrun throttled");
+
+  start = clock_ns ();
+  sched_rt_yield ();
+  if (clock_ns () - start > 100 * MS)
+    fail ("sched_rt_yield waited more than a period");
+  msg ("sched_rt_yield returned");
+
+  CHECK (sched_setrt (0, 0) == 0, "sched_setrt (0, 0)");
+}
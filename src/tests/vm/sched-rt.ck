@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sched-rt) begin
+(sched-rt) budget longer than period refused
+(sched-rt) sched_setrt (100, 50)
+(sched-rt) 95% of the CPU refused
+(sched-rt) thread_create
+(sched-rt) second thread refused
+(sched-rt) sched_setrt (100, 20)
+(sched-rt) overrun throttled
+(sched-rt) sched_rt_yield returned
+(sched-rt) sched_setrt (0, 0)
+(sched-rt) end
+EOF
+pass;
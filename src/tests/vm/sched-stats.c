@@ -0,0 +1,45 @@
+/* Reads the scheduler's measurements before and after blocking
+   in thread_join(), and checks that bad buffers are refused. */
+
+#include <sched.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+nothing (void *aux UNUSED)
+{
+}
+
+void
+test_main (void)
+{
+  struct sched_stats before, after;
+  uint64_t runs;
+  tid_t tid;
+  int i;
+
+  CHECK (sched_stats (&before) == 0, "sched_stats");
+  tid = thread_create (nothing, NULL);
+  CHECK (tid != TID_ERROR, "thread_create");
+  thread_join (tid);
+  CHECK (sched_stats (&after) == 0, "sched_stats again");
+
+  if (after.voluntary_switches <= before.voluntary_switches)
+    fail ("joining did not count as a voluntary switch");
+  runs = 0;
+  for (i = 0; i < SCHED_LATENCY_BUCKETS; i++)
+    {
+      if (after.latency[i] < before.latency[i])
+        fail ("latency bucket %d went down", i);
+      runs += after.latency[i] - before.latency[i];
+    }
+  if (runs == 0)
+    fail ("no wakeup latencies recorded");
+  msg ("counters moved");
+
+  CHECK (sched_stats ((struct sched_stats *) 0xc0000000) == -1,
+         "kernel buffer refused");
+  CHECK (sched_stats ((struct sched_stats *) test_main) == -1,
+         "read-only buffer refused");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sched-stats) begin
+(sched-stats) sched_stats
+(sched-stats) thread_create
+(sched-stats) sched_stats again
+(sched-stats) counters moved
+(sched-stats) kernel buffer refused
+(sched-stats) read-only buffer refused
+(sched-stats) end
+EOF
+pass;
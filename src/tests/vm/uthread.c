@@ -0,0 +1,58 @@
+/* Starts several threads in this process, each of which fills
+   its own part of a shared array on its own stack, then joins
+   them and checks their work and exit codes. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define CHUNK 1024
+
+static int shared[THREAD_CNT * CHUNK];
+
+static void
+fill (void *aux)
+{
+  int id = (int) aux;
+  int local[CHUNK];
+  int i;
+
+  /* Go through a local array so the thread's stack gets used. */
+  for (i = 0; i < CHUNK; i++)
+    local[i] = id * CHUNK + i;
+  for (i = 0; i < CHUNK; i++)
+    shared[id * CHUNK + i] = local[i];
+  if (id == THREAD_CNT - 1)
+    exit (42);
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_create (fill, (void *) i);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_create %d failed", i);
+    }
+  msg ("started %d threads", THREAD_CNT);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      int status = thread_join (tids[i]);
+      int expected = i == THREAD_CNT - 1 ? 42 : 0;
+      if (status != expected)
+        fail ("thread %d exited with %d, expected %d", i, status, expected);
+    }
+  msg ("joined %d threads", THREAD_CNT);
+  CHECK (thread_join (tids[0]) == -1, "second join fails");
+
+  for (i = 0; i < THREAD_CNT * CHUNK; i++)
+    if (shared[i] != i)
+      fail ("shared[%d] is %d, expected %d", i, shared[i], i);
+  msg ("shared array filled in");
+}
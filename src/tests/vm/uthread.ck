@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(uthread) begin
+(uthread) started 4 threads
+(uthread) joined 4 threads
+(uthread) second join fails
+(uthread) shared array filled in
+(uthread) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Reads the process and thread ids from the shared kernel data
+   page in the main thread and in a second thread, then tries to
+   write the page, which must kill the process. */
+
+#include <syscall.h>
+#include <vdso.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static pid_t thread_pid;
+static tid_t thread_tid;
+
+static void
+record_ids (void *aux UNUSED)
+{
+  thread_pid = getpid ();
+  thread_tid = gettid ();
+}
+
+void
+test_main (void)
+{
+  tid_t tid;
+
+  CHECK (getpid () == gettid (), "main thread's tid is the pid");
+
+  tid = thread_create (record_ids, NULL);
+  CHECK (tid != TID_ERROR, "thread_create");
+  thread_join (tid);
+  CHECK (thread_pid == getpid (), "thread sees the same pid");
+  CHECK (thread_tid == tid, "thread sees its own tid");
+
+  msg ("write shared page");
+  *(volatile int32_t *) VDSO_ADDR = 0;
+  fail ("writing the shared page succeeded");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vdso) begin
+(vdso) main thread's tid is the pid
+(vdso) thread_create
+(vdso) thread sees the same pid
+(vdso) thread sees its own tid
+(vdso) write shared page
+vdso: exit(-1)
+EOF
+pass;
@@ -43,12 +43,15 @@
 ////////////////
 
 #include <stdio.h>
+#include <string.h>
 #include "kernel/synch.h"
 #include "kernel/malloc.h"
 #include "kernel/thread.h"
 #include "vm/frame.h"
 #include "vm/swap.h"
 #include "kernel/pagedir.h"
+#include "kernel/process.h"
+#include "kernel/workqueue.h"
 
 #include "kernel/vaddr.h"
 #include "vm/page.h"
@@ -64,6 +67,16 @@ static struct lock lock;			/* Lock for synchronization of frame table */
 static struct hash_iterator hand;	/* Iterator for use as clock hand in ESCRA */
 static struct frame *hand_frame;	/* Hand's current frame for the sake of hash_variable */
 
+/* User pages zeroed ahead of time by a worker thread, so that faults on 
+   zero-fill pages need not clear a page.  Protected by the frame-table 
+   lock.  The pool gives its pages back before anything is evicted, and 
+   is not refilled until a frame is freed again. */
+#define ZERO_POOL_MAX 8
+static void *zero_pool[ZERO_POOL_MAX];
+static int zero_cnt;
+static bool zero_starved;			/* Pool drained for want of memory */
+static struct work zero_work;		/* Refills the pool */
+
 ///////////////
 //           //
 //  Structs  //
@@ -80,6 +93,8 @@ static struct frame *hand_frame;	/* Hand's current frame for the sake of hash_va
 
 unsigned frame_hash (const struct hash_elem *, void *);
 bool frame_less (const struct hash_elem *, const struct hash_elem *, void *);
+static void zero_pool_fill (void *);
+static bool zero_pool_drain (void);
 
 /////////////////
 //             //
@@ -106,6 +121,7 @@ ft_init()
 	frame->addr = 0x0;
 	frame->pinned = true;
 	frame->thread = thread_current ();
+	frame->page = NULL;
 	hash_insert(&frame_table, &frame->hash_elem);
 
 	// Must come after any frame-table modifications
@@ -114,7 +130,8 @@ ft_init()
 	// Call hash_next on hand and set hand_frame to get clock ready
 	hand_frame = hash_entry (hash_next (&hand), struct frame, hash_elem);
 
-	lock_init (&lock);
+	lock_init (&lock, "frame table");
+	work_init (&zero_work, zero_pool_fill, NULL);
 }
 
 /*
@@ -181,13 +198,49 @@ frame_lookup (void *address)
 struct frame *
 allocate_uframe(enum palloc_flags flags)
 {
-	void *addr = palloc_get_page (flags);
+	struct frame *frame = try_allocate_uframe (flags);
 
-	if (!addr)
+	if (!frame && zero_pool_drain ())
+		frame = try_allocate_uframe (flags);
+	if (!frame && evict_page ())
+		frame = try_allocate_uframe (flags);
+
+	return frame;
+}
+
+/*
+ * Function:  try_allocate_uframe
+ * --------------------
+ *	Allocates a user frame only if the user pool has a free page, never 
+ *		evicting to make room. Used for speculative loads such as read-ahead 
+ *		and prefaulting, which should not push out pages already in use. 
+ *		PAL_ZERO requests are served from the pool of pre-zeroed pages 
+ *		first, which is topped up in the background when it runs low.
+ *
+ *  flags: the palloc flags to allocate the page with
+ *
+ *  returns: the new frame, or null if no page was free
+ */
+struct frame *
+try_allocate_uframe (enum palloc_flags flags)
+{
+	void *addr = NULL;
+
+	if (flags & PAL_ZERO)
 	{
-		evict_page ();
-		addr = palloc_get_page (flags);
+		bool low;
+
+		lock_acquire (&lock);
+			if (zero_cnt > 0)
+				addr = zero_pool[--zero_cnt];
+			low = zero_cnt < ZERO_POOL_MAX / 2 && !zero_starved;
+		lock_release (&lock);
+
+		if (low)
+			work_queue (&zero_work);
 	}
+	if (!addr)
+		addr = palloc_get_page (flags);
 
 	if (!addr)
 		return addr;
@@ -195,7 +248,8 @@ allocate_uframe(enum palloc_flags flags)
 	struct frame *frame = (struct frame *) malloc (sizeof (struct frame));
 	frame->addr = addr;
 	frame->pinned = false;
-	frame->thread = thread_current ();
+	frame->thread = process_current ();
+	frame->page = NULL;
 	
 	lock_acquire(&lock);
 		hash_insert(&frame_table, &frame->hash_elem);
@@ -233,6 +287,7 @@ deallocate_uframe_f (struct frame *frame)
 
 	lock_acquire (&lock);
 		hash_delete(&frame_table, &frame->hash_elem);
+		zero_starved = false;
 	lock_release (&lock);
 
 	free (frame);
@@ -241,37 +296,47 @@ deallocate_uframe_f (struct frame *frame)
 /*
  * Function:  evict_page
  * --------------------
- *	Does? Enhanced second-chance clock replacement
- *
- *  params...
+ *	Enhanced second-chance clock replacement. Gives up once the hand 
+ *		has gone round twice, the first turn clearing accessed bits, 
+ *		without finding a victim: then every frame is pinned or cannot be 
+ *		swapped out.
  *
+ *  returns: whether a frame was freed
  */
-
-void
+bool
 evict_page (void)
 {
 	lock_acquire (&lock);
 		hash_variable (&hand);
 
-		struct frame *victim;
+		struct frame *victim = NULL;
 		uint32_t *pd;
 		bool accessed;
 		bool dirty;
 
 		bool found = false;
+		size_t steps = 2 * hash_size (&frame_table);
 
-		while (!found)
+		while (!found && steps-- > 0)
 		{
-			if (!hand_frame->pinned && hash_find (&frame_table, &hand_frame->hash_elem))
+			if (!hand_frame->pinned && hand_frame->page != NULL
+				&& hash_find (&frame_table, &hand_frame->hash_elem))
 			{
+				/* Check the bits of the user's mapping, which the CPU sets on 
+				   user accesses, and of the kernel alias, which it sets when 
+				   the kernel touches the frame directly. */
 				pd = hand_frame->thread->pagedir;
-				accessed = pagedir_is_accessed (pd, hand_frame->addr);
-				dirty = pagedir_is_dirty (pd, hand_frame->addr);
+				accessed = pagedir_is_accessed (pd, hand_frame->page->addr)
+							|| pagedir_is_accessed (pd, hand_frame->addr);
+				dirty = pagedir_is_dirty (pd, hand_frame->page->addr);
 
 				if (!accessed)
 					found = swap_out (hand_frame, dirty);
 				else
+				{
+					pagedir_set_accessed (pd, hand_frame->page->addr, false);
 					pagedir_set_accessed (pd, hand_frame->addr, false);
+				}
 			}
 
 			if (!hash_next (&hand))
@@ -281,7 +346,76 @@ evict_page (void)
 			hand_frame = hash_entry (hash_cur(&hand), struct frame, hash_elem);
 		}
 	lock_release (&lock);
+
+	if (!found)
+		return false;
 	deallocate_uframe_f (victim);
+	return true;
+}
+
+/*
+ * Function:  zero_pool_fill
+ * --------------------
+ *	Work function that tops up the pool of pre-zeroed pages from free user 
+ *		pages, stopping early rather than cause evictions. The page is 
+ *		cleared without the frame-table lock held.
+ */
+static void
+zero_pool_fill (void *aux UNUSED)
+{
+	for (;;)
+	{
+		bool full;
+
+		lock_acquire (&lock);
+			full = zero_cnt >= ZERO_POOL_MAX || zero_starved;
+		lock_release (&lock);
+		if (full)
+			return;
+
+		void *addr = palloc_get_page (PAL_USER);
+		if (!addr)
+			return;
+		memset (addr, 0, PGSIZE);
+
+		lock_acquire (&lock);
+			if (zero_cnt < ZERO_POOL_MAX && !zero_starved)
+			{
+				zero_pool[zero_cnt++] = addr;
+				addr = NULL;
+			}
+		lock_release (&lock);
+
+		if (addr)
+			palloc_free_page (addr);
+	}
+}
+
+/*
+ * Function:  zero_pool_drain
+ * --------------------
+ *	Gives the pre-zeroed pages back to the user pool when it runs out, and 
+ *		stops refills until a frame is freed.
+ *
+ *  returns: whether any page was given back
+ */
+static bool
+zero_pool_drain (void)
+{
+	void *pages[ZERO_POOL_MAX];
+	int i, cnt;
+
+	lock_acquire (&lock);
+		cnt = zero_cnt;
+		for (i = 0; i < cnt; i++)
+			pages[i] = zero_pool[i];
+		zero_cnt = 0;
+		zero_starved = true;
+	lock_release (&lock);
+
+	for (i = 0; i < cnt; i++)
+		palloc_free_page (pages[i]);
+	return cnt > 0;
 }
 
 void
@@ -10,15 +10,17 @@ struct frame
 	void *addr;					/* Physical address of frame */
 	bool pinned;				/* Boolean for pinning */
 	struct thread *thread;		/* Thread to which frame belongs */
+	struct page *page;			/* Page held in frame, null while loading */
 	struct hash_elem hash_elem;	/* Hash-table element */
 };
 
 void ft_init(void);
 struct frame *frame_lookup(void *);
 struct frame *allocate_uframe(enum palloc_flags);
+struct frame *try_allocate_uframe (enum palloc_flags);
 void deallocate_uframe(void *);
 void deallocate_uframe_f (struct frame *);
-void evict_page (void);
+bool evict_page (void);
 void print_ft (void);
 struct lock *get_ft_lock(void);
 
@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <syscall-nr.h>
 #include "vm/page.h"
 #include "filesys/file.h"
 #include "kernel/malloc.h"
@@ -25,6 +26,8 @@
 #include "kernel/thread.h"
 #include "kernel/pagedir.h"
 #include "kernel/interrupt.h"
+#include "kernel/process.h"
+#include "kernel/workqueue.h"
 
 #include "vm/page.h"
 #include "vm/frame.h"
@@ -37,10 +40,51 @@
 //////////////////
 
 static unsigned page_hash (const struct hash_elem *, void *);
-static unsigned page_hash_kva (const struct hash_elem *, void *);
 static bool page_less (const struct hash_elem *, const struct hash_elem *, void *);
-static bool page_less_kva (const struct hash_elem *, const struct hash_elem *, void *);
 static void page_destructor (struct hash_elem *, void *);
+static void page_release (struct page *);
+static bool page_range (const void *, size_t, void **, void **);
+static bool page_pin (struct page *);
+static void page_unpin (struct page *);
+static bool mlock_reserve (int);
+static void mlock_unreserve (int);
+static void willneed_work (void *);
+
+/////////////////
+//             //
+//  Constants  //
+//             //
+/////////////////
+
+#define READ_AHEAD_PAGES 4			/* Pages prefetched past a sequential fault */
+#define DROP_BEHIND_PAGES 8			/* Pages behind a sequential fault made the 
+										clock's preferred victims */
+
+/////////////////////////
+//                     //
+//  Global variables   //
+//                     //
+/////////////////////////
+
+static int mlocked_pages;			/* Pages pinned with mlock, or about to be, 
+										by all processes; under the 
+										frame-table lock */
+
+/////////////
+//         //
+//  Types  //
+//         //
+/////////////
+
+/* A range advised MADV_WILLNEED, brought in by a worker thread. */
+struct willneed
+{
+	struct work work;				/* Queued on the work queue */
+	struct thread *leader;			/* Process the range belongs to, held 
+										with process_get() */
+	void *start;					/* First page of the range */
+	void *end;						/* Page just past the range */
+};
 
 /////////////////
 //             //
@@ -59,20 +103,18 @@ spt_create (void)
 {
 	struct spt *spt = (struct spt *) malloc (sizeof (struct spt));
 	hash_init (&spt->table, page_hash, page_less, NULL);
-	hash_init (&spt->table_kva, page_hash_kva, page_less_kva, NULL);
-	lock_init (&spt->lock);
-	lock_init (&spt->lock_kva);
+	rwlock_init (&spt->lock);
+	lock_init (&spt->fault_lock, "spt fault");
 	return spt;
 }
 
 void
 spt_destroy (struct spt *spt) 
 {
-	lock_acquire (&spt->lock);
-	lock_acquire (&spt->lock_kva);
+	rwlock_acquire_write (&spt->lock);
 		hash_destroy (&spt->table, page_destructor);
-		hash_destroy (&spt->table_kva, NULL);
-		free (spt);
+	rwlock_release_write (&spt->lock);
+	free (spt);
 }
 
 /*
@@ -93,12 +135,15 @@ add_page (struct spt *spt, void *addr)
 {
 	struct page *page = (struct page *) malloc (sizeof (struct page));
 	page->addr = addr;
-	page->pd = thread_current()->pagedir;
-	page->references = 0;
+	page->frame = NULL;
+	/* Nobody else sees the page before it is in the SPT, so its 
+	   bitfields need no lock yet. */
+	page->pinned = false;
+	page->advice = MADV_NORMAL;
 
-	lock_acquire (&spt->lock);
-	    hash_insert (&spt->table, &page->hash_elem);
-    lock_release (&spt->lock);
+	rwlock_acquire_write (&spt->lock);
+		hash_insert (&spt->table, &page->hash_elem);
+	rwlock_release_write (&spt->lock);
 
 	return page;
 }
@@ -107,18 +152,26 @@ add_page (struct spt *spt, void *addr)
  * Function:  remove_page 
  * --------------------
  *	Removes a page entry from the supplemental page table, such as when a page 
- *		is deallocated (see end of setup_stack function in process.c for an 
- *		example). 
+ *		is deallocated (see process_sbrk in process.c for an example). The 
+ *		page's frame and swap slot are freed first, and a page pinned through 
+ *		mlock is unpinned. The caller must hold the SPT's fault lock.
  *
  *  page: the page to be removed from the SPT
  */
 void
 remove_page (struct spt *spt, struct page *page)
 {
-	lock_acquire (&spt->lock);
-		free (hash_delete (&spt->table, &page->hash_elem));
-		free (hash_delete (&spt->table_kva, &page->hash_elem_kva));
-	lock_release (&spt->lock);
+	ASSERT (lock_held_by_current_thread (&spt->fault_lock));
+
+	if (page->pinned)
+		page_unpin (page);
+	page_release (page);
+
+	rwlock_acquire_write (&spt->lock);
+		hash_delete (&spt->table, &page->hash_elem);
+	rwlock_release_write (&spt->lock);
+
+	free (page);
 }
 
 /*
@@ -141,13 +194,6 @@ page_hash (const struct hash_elem *spt_elem, void *aux UNUSED)
 	return hash_int ((int) page->addr);
 }
 
-static unsigned
-page_hash_kva (const struct hash_elem *spt_elem_kva, void *aux UNUSED)
-{
-	const struct page *page = hash_entry (spt_elem_kva, struct page, hash_elem_kva);
-	return hash_int ((int) page->kv_addr);
-}
-
 /*
  * Function:  page_less
  * --------------------
@@ -170,14 +216,6 @@ page_less (const struct hash_elem *first, const struct hash_elem *second, void *
 	return a->addr < b->addr;
 }
 
-static bool
-page_less_kva (const struct hash_elem *first, const struct hash_elem *second, void *aux UNUSED)
-{
-	const struct page *a = hash_entry (first, struct page, hash_elem_kva);
-	const struct page *b = hash_entry (second, struct page, hash_elem_kva);
-	return a->kv_addr < b->kv_addr;
-}
-
 /*
  * Function:  <name>
  * --------------------
@@ -188,7 +226,7 @@ page_destructor (struct hash_elem *elem, void *aux UNUSED)
 {
 	struct page *page = hash_entry (elem, struct page, hash_elem);
 	
-	if(page->swap_index >= 0)
+	if(page->type == PAGE_SWAP && page->swap_index >= 0)
 		delete_from_swap (page->swap_index);
 	
 	free (page);
@@ -213,16 +251,6 @@ page_lookup (struct hash *table, void *addr)
 	return elem != NULL ? hash_entry (elem, struct page, hash_elem) : NULL;
 }
 
-struct page*
-page_lookup_kva (struct hash *table, void *kv_addr)
-{
-	struct page page;
-	struct hash_elem *elem;
-	page.kv_addr = kv_addr;
-	elem = hash_find (table, &page.hash_elem_kva);
-	return elem != NULL ? hash_entry (elem, struct page, hash_elem_kva) : NULL;
-}
-
 /* Copied directly from process.c for use by exception.c in load_page */
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
@@ -262,7 +290,7 @@ reclaim_pages (struct thread *thread)
 {
 	struct spt *spt = thread->spt;
 
-	lock_acquire (&spt->lock);
+	rwlock_acquire_write (&spt->lock);
 		struct page *current;
 		struct hash_iterator hand;
 		hash_first (&hand, &spt->table);
@@ -270,12 +298,14 @@ reclaim_pages (struct thread *thread)
 		while (hash_next (&hand))
 		{
 			current = hash_entry (hash_cur (&hand), struct page, hash_elem);
-			if(current->loaded)
-				deallocate_uframe (current->kv_addr);
+			if(current->frame != NULL)
+				deallocate_uframe (current->frame->addr);
 			pagedir_clear_page (thread->pagedir, current->addr);
 		}
-	lock_release (&spt->lock);
+	rwlock_release_write (&spt->lock);
 
+	mlock_unreserve (thread->locked_pages);
+	thread->locked_pages = 0;
 	spt_destroy (spt);
 }
 
@@ -289,23 +319,19 @@ reclaim_pages (struct thread *thread)
 void
 print_page (struct page *page)
 {
-	//TODO: Figure out how to get PD
-	printf("Page:\t\t%p\nAddress:\t%p\nKV address:\t%p"
+	static const char *types[] = {"Zero", "File", "Swap"};
+	uint32_t *pd = thread_current ()->pagedir;
+
+	printf("Page:\t\t%p\nAddress:\t%p\nFrame:\t\t%p"
 		"\n-----------------------------------"
-		"\n\tPage directory:\t%p"
+		"\n\tType:\t\t%s"
 		"\n\tPinned:\t\t%s"
-		"\n\tLoaded:\t\t%s"
 		"\n\tResident:\t%s"
 		"\n\tSwap index:\t%d"
 		"\n\tAccessed:\t%s"
 		"\n\tDirty:\t\t%s"
-		"\n\tReferences:\t%d"
 		"\n\tStack:\t\t%s"
-		"\n\tBytes to zero:\t%d"
 		"\n\tBytes to read:\t%d"
-		"\n\tNumber:\t\t%d"
-		"\n\tSize:\t\t%d"
-		"\n\tProcess:\t%p"
 		"\n\tWritable:\t%s"
 		"\n\tFile:\t\t%p"
 		"\n\tFile offset:\t%d"
@@ -313,24 +339,18 @@ print_page (struct page *page)
 		"\n\n",
 		page,
 		page->addr,
-		page->kv_addr,
-		page->pd,
+		page->frame,
+		types[page->type],
 		page->pinned ? "True" : "False",
-		page->loaded ? "True" : "False",
-		((uint32_t) page->addr & PTE_P) ? "True" : "False",
-		page->swap_index,
-		pagedir_is_accessed (page->pd, page->kv_addr) ? "True" : "False",
-		pagedir_is_dirty (page->pd, page->kv_addr) ? "True" : "False",
-		page->references,
+		page->frame != NULL ? "True" : "False",
+		page->type == PAGE_SWAP ? page->swap_index : -1,
+		pagedir_is_accessed (pd, page->addr) ? "True" : "False",
+		pagedir_is_dirty (pd, page->addr) ? "True" : "False",
 		page->is_stack ? "True" : "False",
-		page->zero_bytes,
 		page->read_bytes,
-		page->number,
-		page->size,
-		page->proc_addr,
 		page->writable ? "True" : "False",
 		page->file,
-		page->ofs,
+		page->type == PAGE_FILE ? page->ofs : 0,
 		&page->hash_elem);
 }
 
@@ -347,43 +367,508 @@ print_spt (struct spt *spt)
 	printf ("===================================\n");
 }
 
+/*
+ * Function:  set_page
+ * --------------------
+ *	Sets where a new, not yet resident page gets its contents from. 
+ *		Takes the frame-table lock, which guards the page's bitfields.
+ *
+ *  type:		PAGE_ZERO, PAGE_FILE, or PAGE_SWAP for a page that will be 
+ *					given a frame right away
+ *	writable:	whether the user may write to the page
+ *	is_stack:	whether the page is part of the stack
+ *	file, ofs:	for PAGE_FILE, where to read the page from
+ *	read_bytes:	for PAGE_FILE, how much to read; the rest is zeroed
+ */
 void
 set_page (struct page *page,
-			bool loaded,
-			bool pinned,
-			int16_t swap_index,
-			uint8_t references,
-			bool is_stack,
-			int16_t zero_bytes,
-			int16_t read_bytes,
-			uint32_t number,
-			uint32_t size,
-			void *proc_addr,
+			enum page_type type,
 			bool writable,
+			bool is_stack,
 			struct file *file,
-			off_t ofs)
+			off_t ofs,
+			uint32_t read_bytes)
 {
-	page->loaded = loaded;
-	page->pinned = pinned;
-	page->swap_index = swap_index;
-	page->references = references;
-	page->is_stack = is_stack;
-	page->zero_bytes = zero_bytes;
-	page->read_bytes = read_bytes;
-	page->number = number;
-	page->size = size;
-	page->proc_addr = proc_addr;
-	page->writable = writable;
+	ASSERT (read_bytes <= PGSIZE);
+
+	lock_acquire (get_ft_lock ());
+		page->type = type;
+		page->writable = writable;
+		page->is_stack = is_stack;
+		page->read_bytes = read_bytes;
+	lock_release (get_ft_lock ());
 	page->file = file;
-	page->ofs = ofs;
+	if (type == PAGE_FILE)
+		page->ofs = ofs;
+	else
+		page->swap_index = -1;
 }
 
+/*
+ * Function:  set_page_frame
+ * --------------------
+ *	Links PAGE and the FRAME it was just mapped to, making the page 
+ *		resident and the frame a candidate for eviction.
+ */
 void
-set_page_kva (struct spt *spt, struct page *page, void *kva)
+set_page_frame (struct page *page, struct frame *frame)
+{
+	page->frame = frame;
+	frame->page = page;
+}
+
+/*
+ * Function:  page_find
+ * --------------------
+ *	Looks up ADDR in SPT while holding the SPT's lock for reading, so 
+ *		that lookups from one address space do not serialize. The page 
+ *		may only be used after the lookup by a caller that holds the SPT's 
+ *		fault lock, since another thread of the process could otherwise 
+ *		remove it.
+ *
+ *  addr: the page-aligned user address to look for
+ *
+ *  returns: the page at ADDR, or null if ADDR is not in the SPT
+ */
+struct page *
+page_find (struct spt *spt, void *addr)
+{
+	struct page *page;
+
+	rwlock_acquire_read (&spt->lock);
+		page = page_lookup (&spt->table, addr);
+	rwlock_release_read (&spt->lock);
+
+	return page;
+}
+
+/*
+ * Function:  page_in
+ * --------------------
+ *	Makes a page resident, from swap if it was swapped out, otherwise from 
+ *		its file or as a zeroed page. Does nothing if another thread of the 
+ *		process already brought it in. The caller must hold the SPT's fault 
+ *		lock.
+ *
+ *  page: the page to bring in
+ *
+ *  returns: whether the page is resident afterwards
+ */
+bool
+page_in (struct page *page)
+{
+	if (page->frame != NULL)
+		return true;
+	if (page->type == PAGE_SWAP)
+		return swap_in (page);
+	return load_page (page);
+}
+
+/*
+ * Function:  page_stream
+ * --------------------
+ *	Called after a fault on a page advised MADV_SEQUENTIAL. Prefetches the 
+ *		next few pages of the sequential range, as long as free frames are 
+ *		available, and clears the accessed bits of the pages just behind the 
+ *		fault so the clock evicts them before anything else (drop-behind).
+ *
+ *  page: the page that was just faulted in
+ */
+void
+page_stream (struct spt *spt, struct page *page)
+{
+	uint32_t *pd = thread_current ()->pagedir;
+	struct page *p;
+	int i;
+
+	/* Read ahead. */
+	for (i = 1; i <= READ_AHEAD_PAGES; i++)
+	{
+		p = page_find (spt, page->addr + i * PGSIZE);
+		if (p == NULL || p->advice != MADV_SEQUENTIAL)
+			break;
+		if (p->frame != NULL || p->type == PAGE_SWAP)
+			continue;
+		if (!prefetch_page (p))
+			break;
+	}
+
+	/* Drop behind. */
+	for (i = 1; i <= DROP_BEHIND_PAGES; i++)
+	{
+		p = page_find (spt, page->addr - i * PGSIZE);
+		if (p == NULL || p->advice != MADV_SEQUENTIAL)
+			break;
+		lock_acquire (get_ft_lock ());
+			if (p->frame != NULL)
+			{
+				pagedir_set_accessed (pd, p->addr, false);
+				pagedir_set_accessed (pd, p->frame->addr, false);
+			}
+		lock_release (get_ft_lock ());
+	}
+}
+
+/*
+ * Function:  page_advise
+ * --------------------
+ *	Applies an madvise hint to every page of the current process's SPT in 
+ *		the range [ADDR, ADDR + LENGTH). Holes in the range are skipped. 
+ *		MADV_WILLNEED only queues the range for a worker thread to bring 
+ *		in, so that the caller does not wait for the reads.
+ *
+ *  addr: 	the page-aligned start of the range
+ *	length:	the length of the range in bytes
+ *	advice:	one of the MADV_* values
+ *
+ *  returns: false if the range or the advice is invalid, true otherwise
+ */
+bool
+page_advise (struct spt *spt, void *addr, size_t length, int advice)
+{
+	void *end = pg_round_up (addr + length);
+	struct page *page;
+
+	if (pg_ofs (addr) != 0 || addr + length < addr || end > PHYS_BASE)
+		return false;
+	if (advice < MADV_NORMAL || advice > MADV_DONTNEED)
+		return false;
+
+	if (advice == MADV_WILLNEED)
+	{
+		struct willneed *w = malloc (sizeof *w);
+
+		/* The advice is only a hint, so being short of memory for it is 
+		   no error. */
+		if (w != NULL)
+		{
+			w->leader = process_get ();
+			w->start = addr;
+			w->end = end;
+			work_init (&w->work, willneed_work, w);
+			work_queue (&w->work);
+		}
+		return true;
+	}
+
+	lock_acquire (&spt->fault_lock);
+	for (; addr < end; addr += PGSIZE)
+	{
+		page = page_find (spt, addr);
+		if (page == NULL)
+			continue;
+
+		switch (advice)
+		{
+			case MADV_NORMAL:
+			case MADV_SEQUENTIAL:
+				lock_acquire (get_ft_lock ());
+					page->advice = advice;
+				lock_release (get_ft_lock ());
+				break;
+			case MADV_DONTNEED:
+				page_release (page);
+				break;
+		}
+	}
+	lock_release (&spt->fault_lock);
+	return true;
+}
+
+/*
+ * Function:  page_release
+ * --------------------
+ *	Frees a page's frame and swap slot right away. The page stays in the 
+ *		SPT: a page still backed by its file is read from it again on the 
+ *		next fault, any other page comes back zeroed. Pinned pages are left 
+ *		alone.
+ *
+ *  page: the page to release
+ */
+static void
+page_release (struct page *page)
+{
+	uint32_t *pd = thread_current ()->pagedir;
+	struct frame *frame = NULL;
+
+	if (page->pinned)
+		return;
+
+	/* Pin the frame first so the clock cannot pick it while we free it.  
+	   Eviction unlinks the page from its frame under the frame-table 
+	   lock, so a page that still has a frame here is not being evicted. */
+	lock_acquire (get_ft_lock ());
+		frame = page->frame;
+		if (frame)
+			frame->pinned = true;
+	lock_release (get_ft_lock ());
+
+	if (frame)
+	{
+		pagedir_clear_page (pd, page->addr);
+		page->frame = NULL;
+		deallocate_uframe_f (frame);
+	}
+
+	/* Anonymous contents are gone now, so the page comes back zeroed. */
+	if (page->type == PAGE_SWAP)
+	{
+		if (page->swap_index > -1)
+			delete_from_swap (page->swap_index);
+		set_page (page, PAGE_ZERO, page->writable, page->is_stack, NULL, 0, 0);
+	}
+}
+
+/*
+ * Function:  willneed_work
+ * --------------------
+ *	Work function that brings in the pages of a range advised 
+ *		MADV_WILLNEED, acting for the range's process as one of its own 
+ *		threads would, then drops the process and frees the request. Does 
+ *		nothing if the process is already exiting.
+ *
+ *  w_: the struct willneed
+ */
+static void
+willneed_work (void *w_)
 {
-	page->kv_addr = kva;
+	struct willneed *w = w_;
+	struct spt *spt = w->leader->spt;
+	struct page *page;
+	void *upage;
+
+	if (!w->leader->exiting)
+	{
+		process_enter (w->leader);
+		lock_acquire (&spt->fault_lock);
+		for (upage = w->start; upage < w->end; upage += PGSIZE)
+		{
+			page = page_find (spt, upage);
+			if (page != NULL)
+				page_in (page);
+		}
+		lock_release (&spt->fault_lock);
+		process_leave ();
+	}
+
+	process_put (w->leader);
+	free (w);
+}
+
+/*
+ * Function:  page_range
+ * --------------------
+ *	Rounds the range [ADDR, ADDR + LENGTH) out to whole pages.
+ *
+ *  start:	set to the first page of the range
+ *	end:	set to the page just past the range
+ *
+ *  returns: false if the range wraps around or leaves user space
+ */
+static bool
+page_range (const void *addr, size_t length, void **start, void **end)
+{
+	if ((uint8_t *) addr + length < (uint8_t *) addr)
+		return false;
+
+	*start = pg_round_down (addr);
+	*end = pg_round_up ((uint8_t *) addr + length);
+	return *end <= PHYS_BASE;
+}
+
+/*
+ * Function:  page_pin
+ * --------------------
+ *	Faults PAGE in if needed and pins it and its frame, so that the clock 
+ *		never evicts it. Retries if the page is evicted again between being 
+ *		faulted in and being pinned.
+ *
+ *  page: the page to pin
+ *
+ *  returns: whether the page could be brought in and pinned
+ */
+static bool
+page_pin (struct page *page)
+{
+	struct frame *frame = NULL;
+
+	while (frame == NULL)
+	{
+		if (page->frame == NULL && !page_in (page))
+			return false;
+
+		lock_acquire (get_ft_lock ());
+			frame = page->frame;
+			if (frame)
+			{
+				frame->pinned = true;
+				page->pinned = true;
+			}
+		lock_release (get_ft_lock ());
+	}
+	return true;
+}
 
-	lock_acquire (&spt->lock_kva);
-		hash_insert (&spt->table_kva, &page->hash_elem_kva);
-	lock_release (&spt->lock_kva);
+/*
+ * Function:  page_mlock
+ * --------------------
+ *	Faults in and pins every page of the current process in the range 
+ *		[ADDR, ADDR + LENGTH). Fails without pinning anything if part of the 
+ *		range is not in the SPT, if pinning it would take the process past 
+ *		MLOCK_MAX_PAGES or all processes past their share of the user pool, 
+ *		or if a page cannot be brought in; pages pinned before the failure 
+ *		are unpinned again.
+ *
+ *  addr: 	the start of the range
+ *	length:	the length of the range in bytes
+ *
+ *  returns: whether the whole range is now pinned
+ */
+bool
+page_mlock (struct spt *spt, const void *addr, size_t length)
+{
+	struct thread *t = process_current ();
+	struct page *page;
+	void *start, *end, *upage;
+	uint64_t pinned = 0;			/* Bit I: page I of the range pinned here */
+	int new_pages = 0;
+	int done = 0;
+	int i;
+
+	if (!page_range (addr, length, &start, &end))
+		return false;
+
+	lock_acquire (&spt->fault_lock);
+	for (upage = start; upage < end; upage += PGSIZE)
+	{
+		page = page_find (spt, upage);
+		if (page == NULL)
+			goto fail;
+		if (!page->pinned)
+			new_pages++;
+	}
+	if (t->locked_pages + new_pages > MLOCK_MAX_PAGES
+		|| !mlock_reserve (new_pages))
+		goto fail;
+
+	/* The pages of the range already pinned count in LOCKED_PAGES, so 
+	   the range has no more than MLOCK_MAX_PAGES pages. */
+	ASSERT ((size_t) (end - start) / PGSIZE <= MLOCK_MAX_PAGES);
+	ASSERT (MLOCK_MAX_PAGES <= 64);
+	for (upage = start, i = 0; upage < end; upage += PGSIZE, i++)
+	{
+		page = page_find (spt, upage);
+		if (page->pinned)
+			continue;
+		if (!page_pin (page))
+			goto unwind;
+		pinned |= (uint64_t) 1 << i;
+		t->locked_pages++;
+		done++;
+	}
+	lock_release (&spt->fault_lock);
+	return true;
+
+ unwind:
+	mlock_unreserve (new_pages - done);
+	for (upage = start, i = 0; upage < end; upage += PGSIZE, i++)
+		if (pinned & ((uint64_t) 1 << i))
+			page_unpin (page_find (spt, upage));
+ fail:
+	lock_release (&spt->fault_lock);
+	return false;
+}
+
+/*
+ * Function:  page_munlock
+ * --------------------
+ *	Unpins every page of the current process in the range 
+ *		[ADDR, ADDR + LENGTH) that was pinned with page_mlock.
+ *
+ *  addr: 	the start of the range
+ *	length:	the length of the range in bytes
+ *
+ *  returns: false if the range is invalid, true otherwise
+ */
+bool
+page_munlock (struct spt *spt, const void *addr, size_t length)
+{
+	struct page *page;
+	void *start, *end, *upage;
+
+	if (!page_range (addr, length, &start, &end))
+		return false;
+
+	lock_acquire (&spt->fault_lock);
+	for (upage = start; upage < end; upage += PGSIZE)
+	{
+		page = page_find (spt, upage);
+		if (page != NULL && page->pinned)
+			page_unpin (page);
+	}
+	lock_release (&spt->fault_lock);
+	return true;
+}
+
+/*
+ * Function:  page_unpin
+ * --------------------
+ *	Unpins PAGE, which page_mlock pinned, and its frame, and takes it off 
+ *		the process's and the system's counts of locked pages.
+ *
+ *  page: the pinned page
+ */
+static void
+page_unpin (struct page *page)
+{
+	struct frame *frame;
+
+	lock_acquire (get_ft_lock ());
+		frame = page->frame;
+		if (frame)
+			frame->pinned = false;
+		page->pinned = false;
+		mlocked_pages--;
+	lock_release (get_ft_lock ());
+	process_current ()->locked_pages--;
+}
+
+/*
+ * Function:  mlock_reserve
+ * --------------------
+ *	Counts CNT more pages as pinned with mlock, unless that would pin more 
+ *		than 1/MLOCK_POOL_DIVISOR of the user pool.
+ *
+ *  cnt: the number of pages about to be pinned
+ *
+ *  returns: whether the pages were counted
+ */
+static bool
+mlock_reserve (int cnt)
+{
+	int limit = palloc_user_pages () / MLOCK_POOL_DIVISOR;
+	bool ok;
+
+	lock_acquire (get_ft_lock ());
+		ok = mlocked_pages + cnt <= limit;
+		if (ok)
+			mlocked_pages += cnt;
+	lock_release (get_ft_lock ());
+	return ok;
+}
+
+/*
+ * Function:  mlock_unreserve
+ * --------------------
+ *	Stops counting CNT pages as pinned with mlock, when they were never 
+ *		pinned after all or when their process exits.
+ *
+ *  cnt: the number of pages
+ */
+static void
+mlock_unreserve (int cnt)
+{
+	lock_acquire (get_ft_lock ());
+		mlocked_pages -= cnt;
+	lock_release (get_ft_lock ());
 }
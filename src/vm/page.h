@@ -6,41 +6,70 @@
 #include "kernel/synch.h"
 #include "filesys/off_t.h"
 
+struct frame;
+
+/* Maximum number of pages a process may pin with mlock. */
+#define MLOCK_MAX_PAGES 64
+
+/* All processes together may pin at most 1/MLOCK_POOL_DIVISOR of 
+   the user pool with mlock, so that eviction always has frames to 
+   choose from. */
+#define MLOCK_POOL_DIVISOR 2
+
+/* The threads of a process share one SPT.  Faults, madvise, mlock 
+   and munlock, and sbrk or a thread's exit removing pages, hold 
+   FAULT_LOCK from looking a page up until they are done with it, so 
+   that a page is never brought in twice at once nor freed while 
+   another thread uses it. */
 struct spt
 {
 	struct hash table;				/* Supplemental page table. */
-	struct hash table_kva;			/* SPT's secondary hash table */
-    struct lock lock;				/* Lock for synchronization of SPT */
-    struct lock lock_kva;			/* Lock for synchronization of table_kva */
+	struct rwlock lock;				/* Readers look up, writers insert 
+										and remove */
+	struct lock fault_lock;			/* Held across lookup and use of a 
+										page; see above */
+};
+
+/* Where a page's contents come from when it is not resident. */
+enum page_type
+{
+	PAGE_ZERO,						/* Zero-filled, never written */
+	PAGE_FILE,						/* READ_BYTES from FILE at OFS, then zeros */
+	PAGE_SWAP						/* Anonymous, in swap slot SWAP_INDEX when 
+										not resident */
 };
 
+/* One SPT entry per user page, packed into 28 bytes so that it takes 
+   a 32-byte block from the kernel malloc. The frame, if any, points 
+   back at the page, and the page directory and owner are those of 
+   the SPT's thread, so neither is stored here.
+
+   The bitfields share one word, and writing any of them rewrites the 
+   others, so once the page is in the SPT every write to a bitfield 
+   holds the frame-table lock. Eviction changes TYPE under that lock, 
+   which would otherwise race with the owner changing ADVICE or 
+   PINNED. */
 struct page
 {
 	void *addr;						/* Virtual address of page */
-	void *kv_addr;					/* Address of page from palloc_get_page */
-	void *pd;						/* Page directory associated with page */
-	bool loaded;					/* Page is loaded from file or not */
-	bool pinned;					/* Page is pinned or not */
-	int16_t swap_index;				/* Page's index in swap table if swapped */
-	uint8_t references;				/* Number of references to this page */
-	bool is_stack;					/* Page is part of process stack or not */
-	int16_t zero_bytes;				/* Amount of page to be zeroed */
-	int16_t read_bytes;				/* Amoutn of page to be read */
-	uint32_t number;				/* Assignment number to designate order of 
-										creation or being swapped in */
-	uint32_t size;					/* Size of data */
-	void *proc_addr;				/* Address of process (thread) to which
-										page belongs */
-	uint32_t *pagedir;				/* Page directory page is in */
-	bool writable;					/* Page is writable or not*/
+	struct frame *frame;			/* Frame holding the page, null if not 
+										resident */
 	struct file *file;				/* The file the page is loaded from */
-	off_t ofs;						/* The offset the page is at within file */
+	union
+	{
+		off_t ofs;					/* PAGE_FILE: offset of page within file */
+		int32_t swap_index;			/* PAGE_SWAP: index in swap table, -1 
+										while resident */
+	};
+	/* Written under the frame-table lock; see above. */
+	unsigned read_bytes : 13;		/* PAGE_FILE: bytes to read, rest zeroed */
+	unsigned type : 2;				/* enum page_type */
+	unsigned writable : 1;			/* Page is writable or not */
+	unsigned pinned : 1;			/* Page is pinned by mlock or not */
+	unsigned is_stack : 1;			/* Page is part of process stack or not */
+	unsigned advice : 2;			/* MADV_* hint given through madvise */
 	struct hash_elem hash_elem;		/* The hash element used to store a page in 
 										the SPT hash-table */
-	struct hash_elem hash_elem_kva;	/* The hash element used to store a page in 
-										the SPTs secondary hash-table for quick
-										translation from a virtual adress to a
-										kernel virtual address */
 };
 
 struct spt *spt_create (void);
@@ -48,29 +77,21 @@ void spt_destroy (struct spt *);
 void remove_page (struct spt *, struct page *);
 struct page *add_page (struct spt *, void *);
 struct page *page_lookup (struct hash *, void *);
-struct page* page_lookup_kva (struct hash *, void *);
+struct page *page_find (struct spt *, void *);
 bool install_page (void *, void *, bool);
 bool is_writable_buffer (char **, unsigned);
 void reclaim_pages (struct thread *);
+bool page_in (struct page *);
+void page_stream (struct spt *, struct page *);
+bool page_advise (struct spt *, void *, size_t, int);
+bool page_mlock (struct spt *, const void *, size_t);
+bool page_munlock (struct spt *, const void *, size_t);
 
 void print_page (struct page *);
 void print_spt (struct spt *spt);
 bool is_resident (void *);
-void set_page (struct page *p,
-				bool loaded,
-				bool pinned,
-				int16_t swap_index,
-				uint8_t references,
-				bool is_stack,
-				int16_t zero_bytes,
-				int16_t read_bytes,
-				uint32_t number,
-				uint32_t size,
-				void *proc_addr,
-				bool writable,
-				struct file *file,
-				off_t ofs);
-
-void set_page_kva (struct spt *, struct page *, void *);
+void set_page (struct page *, enum page_type, bool, bool, struct file *,
+				off_t, uint32_t);
+void set_page_frame (struct page *, struct frame *);
 
 #endif  /* vm/page.h */
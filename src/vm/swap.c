@@ -53,7 +53,7 @@ static const uint32_t PGS_PER_BLK = PGSIZE / BLOCK_SECTOR_SIZE;
 void
 st_init (void)
 {
-	lock_init (&lock);
+	lock_init (&lock, "swap table");
 }
 
 void
@@ -70,20 +70,29 @@ delete_from_swap (uint32_t index)
 	bitmap_reset (swap_table, index);
 }
 
+/*
+ * Function:  swap_out
+ * --------------------
+ *	Evicts the page held in FRAME. Anonymous pages, and file or zero pages 
+ *		that were written to, go to a free swap slot and become PAGE_SWAP; 
+ *		clean file and zero pages are simply dropped, to be read or zeroed 
+ *		again on the next fault.
+ *
+ *  frame: the frame to evict, which the caller frees afterwards
+ *	dirty: whether the page was written to through the user's mapping
+ *
+ *  returns: true
+ */
 bool
 swap_out (struct frame *frame, bool dirty)
 {
 	ASSERT (frame);
 
 	lock_acquire (&lock);
-		lock_acquire (&frame->thread->spt->lock_kva);
-			struct page *page = page_lookup_kva (&frame->thread->spt->table_kva, frame->addr);
-		lock_release (&frame->thread->spt->lock_kva);
+		struct page *page = frame->page;
 		ASSERT (page);
 
-		page->pinned = frame->pinned;
-
-		if (dirty || page->is_stack)
+		if (dirty || page->type == PAGE_SWAP)
 		{
 			int index = bitmap_scan (swap_table, 0, 1, 0);
 
@@ -94,31 +103,42 @@ swap_out (struct frame *frame, bool dirty)
 			for (counter = 0; counter < PGS_PER_BLK; counter++)
 				block_write (swap_space,
 							(index * PGS_PER_BLK) + counter,
-							page->addr + (counter * BLOCK_SECTOR_SIZE));
+							frame->addr + (counter * BLOCK_SECTOR_SIZE));
 
 			bitmap_mark (swap_table, index);
+			page->type = PAGE_SWAP;
 			page->swap_index = index;
+			thread_rusage (frame->thread)->swap_outs++;
 		}
 		pagedir_clear_page (frame->thread->pagedir, page->addr);
+		page->frame = NULL;
+		frame->page = NULL;
 	lock_release (&lock);
 
 	return true;
 }
 
-void
-swap_in (void *addr)
+/*
+ * Function:  swap_in
+ * --------------------
+ *	Reads PAGE back from its swap slot into a new frame, frees the slot and 
+ *		maps the page. The page stays PAGE_SWAP, so it is written to swap 
+ *		again if it is evicted, dirty or not.
+ *
+ *  page: a non-resident PAGE_SWAP page of the current process
+ *
+ *  returns: whether a frame could be found for the page
+ */
+bool
+swap_in (struct page *page)
 {
 	struct frame *frame = allocate_uframe (PAL_USER);
-	ASSERT (frame);
+	ASSERT (page->type == PAGE_SWAP);
+	if (!frame)
+		return false;
 
 	lock_acquire (&lock);
-		lock_acquire (&frame->thread->spt->lock);
-			struct page *page = page_lookup (&frame->thread->spt->table, addr);
-		lock_release (&frame->thread->spt->lock);
-		ASSERT (page);
-
 		frame->pinned = page->pinned;
-		install_page (addr, frame->addr, page->writable);
 
 		int32_t index = page->swap_index;
 		ASSERT (index > -1);
@@ -127,11 +147,16 @@ swap_in (void *addr)
 		for (counter = 0; counter < PGS_PER_BLK; counter++)
 				block_read (swap_space,
 							(index * PGS_PER_BLK) + counter,
-							page->addr + (counter * BLOCK_SECTOR_SIZE));
+							frame->addr + (counter * BLOCK_SECTOR_SIZE));
 
-		bitmap_reset (swap_table, page->swap_index);
+		bitmap_reset (swap_table, index);
 		page->swap_index = -1;
+		thread_rusage (thread_current ())->swap_ins++;
+
+		install_page (page->addr, frame->addr, page->writable);
+		set_page_frame (page, frame);
 	lock_release (&lock);
+	return true;
 }
 
 struct lock *
@@ -8,7 +8,7 @@ void st_init (void);
 void st_init_swap_space (void);
 void delete_from_swap (uint32_t);
 bool swap_out (struct frame *, bool);
-void swap_in (void *);
+bool swap_in (struct page *);
 struct lock *get_st_lock(void);
 
 #endif  /* vm/swap.h */